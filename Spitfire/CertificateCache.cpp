@@ -0,0 +1,63 @@
+#include "CertificateCache.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	CertificateCache& CertificateCache::Instance()
+	{
+		static CertificateCache* const cache = new CertificateCache();
+		return *cache;
+	}
+
+	void CertificateCache::SetEnabled(bool enabled)
+	{
+		rtc::CritScope lock(&crit_);
+		enabled_ = enabled;
+		if (!enabled_)
+			certificate_ = nullptr;
+	}
+
+	bool CertificateCache::IsEnabled() const
+	{
+		rtc::CritScope lock(&crit_);
+		return enabled_;
+	}
+
+	void CertificateCache::SetRotationInterval(uint64_t rotation_ms)
+	{
+		rtc::CritScope lock(&crit_);
+		rotationMs_ = rotation_ms;
+	}
+
+	rtc::scoped_refptr<rtc::RTCCertificate> CertificateCache::GetCertificate()
+	{
+		// Held while generating so a burst of connections waits on one key pair.
+		rtc::CritScope lock(&crit_);
+		if (!enabled_)
+			return nullptr;
+
+		const int64_t now = rtc::TimeMillis();
+		const bool rotate = rotationMs_ > 0 && now - generatedAtMs_ >= static_cast<int64_t>(rotationMs_);
+		const bool expiring = certificate_ && certificate_->HasExpired(rtc::TimeUTCMillis() + kMinRemainingValidityMs);
+		if (certificate_ && !rotate && !expiring)
+			return certificate_;
+
+		absl::optional<uint64_t> expires_ms;
+		if (rotationMs_ > 0)
+			expires_ms = rotationMs_ + kMinRemainingValidityMs;
+
+		auto certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams::ECDSA(rtc::EC_NIST_P256), expires_ms);
+		if (!certificate)
+		{
+			RTC_LOG(LS_ERROR) << "Failed to generate a cached certificate, keeping the previous one";
+			return certificate_;
+		}
+
+		RTC_LOG(INFO) << __FUNCTION__ << " generated certificate in " << rtc::TimeMillis() - now << "ms";
+		certificate_ = certificate;
+		generatedAtMs_ = now;
+		return certificate_;
+	}
+}
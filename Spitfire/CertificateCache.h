@@ -0,0 +1,39 @@
+#pragma once
+
+#include "api/scoped_refptr.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/rtc_certificate.h"
+
+namespace Spitfire
+{
+	// Process wide DTLS certificate shared by every peer connection. Generating a
+	// key pair is the slowest part of connection setup, with the cache enabled it
+	// is paid once per rotation instead of once per peer.
+	class CertificateCache
+	{
+	public:
+		// Certificates are replaced when less than this much validity remains.
+		static const uint64_t kMinRemainingValidityMs = 24 * 60 * 60 * 1000;
+
+		static CertificateCache& Instance();
+
+		void SetEnabled(bool enabled);
+		bool IsEnabled() const;
+
+		// Certificates older than |rotation_ms| are replaced on next use, zero keeps
+		// one until it is close to expiring.
+		void SetRotationInterval(uint64_t rotation_ms);
+
+		// Returns the current ECDSA P-256 certificate, generating it if needed.
+		rtc::scoped_refptr<rtc::RTCCertificate> GetCertificate();
+
+	private:
+		CertificateCache() = default;
+
+		rtc::CriticalSection crit_;
+		bool enabled_ = false;
+		uint64_t rotationMs_ = 0;
+		int64_t generatedAtMs_ = 0;
+		rtc::scoped_refptr<rtc::RTCCertificate> certificate_;
+	};
+}
@@ -0,0 +1,125 @@
+#include "CertificatePool.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	CertificatePool& CertificatePool::Instance()
+	{
+		static CertificatePool* const pool = new CertificatePool();
+		return *pool;
+	}
+
+	void CertificatePool::Start(size_t capacity, size_t low_water)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			capacity_ = capacity;
+			lowWater_ = std::min(low_water, capacity);
+			if (!thread_)
+			{
+				thread_ = rtc::Thread::Create();
+				thread_->SetName("spitfire_cert_pool", nullptr);
+				thread_->Start();
+			}
+		}
+		RequestRefill();
+	}
+
+	void CertificatePool::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+			capacity_ = 0;
+			refilling_ = false;
+			ready_.clear();
+		}
+
+		// Joined outside the lock, the refill loop takes it between certificates.
+		if (thread)
+			thread->Stop();
+	}
+
+	bool CertificatePool::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return thread_ != nullptr;
+	}
+
+	rtc::scoped_refptr<rtc::RTCCertificate> CertificatePool::Take()
+	{
+		rtc::scoped_refptr<rtc::RTCCertificate> certificate;
+		{
+			rtc::CritScope lock(&crit_);
+			while (!ready_.empty() && !certificate)
+			{
+				certificate = ready_.front();
+				ready_.pop_front();
+				if (certificate->HasExpired(rtc::TimeUTCMillis()))
+					certificate = nullptr;
+			}
+
+			if (certificate)
+				hits_++;
+			else
+				misses_++;
+		}
+
+		RequestRefill();
+		return certificate;
+	}
+
+	RtcCertificatePoolInfo CertificatePool::GetInfo() const
+	{
+		auto info = RtcCertificatePoolInfo();
+		rtc::CritScope lock(&crit_);
+		info.ready = static_cast<uint32_t>(ready_.size());
+		info.generated = generated_;
+		info.hits = hits_;
+		info.misses = misses_;
+		return info;
+	}
+
+	void CertificatePool::RequestRefill()
+	{
+		rtc::CritScope lock(&crit_);
+		if (!thread_ || refilling_ || ready_.size() > lowWater_)
+			return;
+
+		refilling_ = true;
+		thread_->PostTask(RTC_FROM_HERE, [this]() { Refill(); });
+	}
+
+	void CertificatePool::Refill()
+	{
+		for (;;)
+		{
+			{
+				rtc::CritScope lock(&crit_);
+				if (!thread_ || ready_.size() >= capacity_)
+				{
+					refilling_ = false;
+					return;
+				}
+			}
+
+			auto certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams::ECDSA(rtc::EC_NIST_P256), absl::nullopt);
+			if (!certificate)
+			{
+				RTC_LOG(LS_ERROR) << "Failed to pre-generate a certificate";
+				rtc::CritScope lock(&crit_);
+				refilling_ = false;
+				return;
+			}
+
+			rtc::CritScope lock(&crit_);
+			ready_.push_back(certificate);
+			generated_++;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "api/scoped_refptr.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/rtc_certificate.h"
+#include "rtc_base/thread.h"
+
+namespace Spitfire
+{
+	struct RtcCertificatePoolInfo
+	{
+		uint32_t ready;
+		uint64_t generated;
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	// Distinct per-peer DTLS certificates generated ahead of demand on a
+	// background thread, so a burst of new connections never waits on key
+	// generation. The pool is refilled whenever it drops to its low-water mark.
+	class CertificatePool
+	{
+	public:
+		static CertificatePool& Instance();
+
+		// Starts the background thread and fills the pool up to |capacity|.
+		void Start(size_t capacity, size_t low_water);
+		void Stop();
+		bool IsRunning() const;
+
+		// Returns a ready certificate, or null if the pool is empty. A miss leaves
+		// generation to the peer connection, which does it off the signaling thread.
+		rtc::scoped_refptr<rtc::RTCCertificate> Take();
+
+		RtcCertificatePoolInfo GetInfo() const;
+
+	private:
+		CertificatePool() = default;
+
+		void RequestRefill();
+		void Refill();
+
+		rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		std::deque<rtc::scoped_refptr<rtc::RTCCertificate>> ready_;
+		size_t capacity_ = 0;
+		size_t lowWater_ = 0;
+		bool refilling_ = false;
+
+		uint64_t generated_ = 0;
+		uint64_t hits_ = 0;
+		uint64_t misses_ = 0;
+	};
+}
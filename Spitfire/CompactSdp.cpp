@@ -0,0 +1,188 @@
+#include "CompactSdp.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "p2p/base/transport_description.h"
+#include "pc/session_description.h"
+#include "rtc_base/byte_buffer.h"
+#include "rtc_base/ssl_fingerprint.h"
+
+namespace Spitfire
+{
+	namespace
+	{
+		bool WriteShortString(rtc::ByteBufferWriter& writer, const std::string& value)
+		{
+			if (value.size() > 0xFF)
+				return false;
+
+			writer.WriteUInt8(static_cast<uint8_t>(value.size()));
+			writer.WriteString(value);
+			return true;
+		}
+
+		bool ReadShortString(rtc::ByteBufferReader& reader, std::string* value)
+		{
+			uint8_t length;
+			return reader.ReadUInt8(&length) && reader.ReadString(value, length);
+		}
+	}
+
+	bool CompactSdp::FromDescription(const webrtc::SessionDescriptionInterface* desc, RtcCompactDescription* out)
+	{
+		if (!desc || !desc->description())
+			return false;
+
+		const auto& contents = desc->description()->contents();
+		if (contents.size() != 1 || contents[0].rejected || contents[0].type != cricket::MediaProtocolType::kSctp)
+			return false;
+
+		const auto* sctp = contents[0].media_description()->as_sctp();
+		const auto* transport = desc->description()->GetTransportDescriptionByName(contents[0].name);
+		if (!sctp || !transport || !transport->identity_fingerprint)
+			return false;
+
+		out->type = desc->type();
+		out->sessionId = std::strtoull(desc->session_id().c_str(), nullptr, 10);
+		out->mid = contents[0].name;
+		out->iceUfrag = transport->ice_ufrag;
+		out->icePwd = transport->ice_pwd;
+		out->fingerprintAlgorithm = transport->identity_fingerprint->algorithm;
+		out->fingerprint.assign(transport->identity_fingerprint->digest.data<char>(), transport->identity_fingerprint->digest.size());
+		out->setup.clear();
+		cricket::ConnectionRoleToString(transport->connection_role, &out->setup);
+		out->sctpPort = sctp->port();
+		out->maxMessageSize = sctp->max_message_size();
+
+		out->candidates.clear();
+		const auto* candidates = desc->candidates(0);
+		for (size_t i = 0; candidates && i < candidates->count(); i++)
+		{
+			std::string candidate;
+			if (candidates->at(i)->ToString(&candidate))
+				out->candidates.push_back(candidate);
+		}
+		return true;
+	}
+
+	bool CompactSdp::Serialize(const RtcCompactDescription& compact, std::string* out)
+	{
+		auto type = webrtc::SdpTypeFromString(compact.type);
+		if (!type || *type > webrtc::SdpType::kAnswer)
+			return false;
+
+		if (compact.sctpPort < 0 || compact.sctpPort > 0xFFFF || compact.maxMessageSize < 0 || compact.candidates.size() > 0xFF)
+			return false;
+
+		cricket::ConnectionRole role = cricket::CONNECTIONROLE_NONE;
+		cricket::StringToConnectionRole(compact.setup, &role);
+
+		rtc::ByteBufferWriter writer;
+		writer.WriteUInt8(kMagic);
+		writer.WriteUInt8(kVersion);
+		writer.WriteUInt8(static_cast<uint8_t>(*type));
+		writer.WriteUInt8(static_cast<uint8_t>(role));
+		writer.WriteUInt64(compact.sessionId);
+		if (!WriteShortString(writer, compact.mid) ||
+			!WriteShortString(writer, compact.iceUfrag) ||
+			!WriteShortString(writer, compact.icePwd) ||
+			!WriteShortString(writer, compact.fingerprintAlgorithm) ||
+			!WriteShortString(writer, compact.fingerprint))
+		{
+			return false;
+		}
+		writer.WriteUInt16(static_cast<uint16_t>(compact.sctpPort));
+		writer.WriteUInt32(static_cast<uint32_t>(compact.maxMessageSize));
+
+		writer.WriteUInt8(static_cast<uint8_t>(compact.candidates.size()));
+		for (auto const& candidate : compact.candidates)
+		{
+			if (candidate.size() > 0xFFFF)
+				return false;
+
+			writer.WriteUInt16(static_cast<uint16_t>(candidate.size()));
+			writer.WriteString(candidate);
+		}
+		out->assign(writer.Data(), writer.Length());
+		return true;
+	}
+
+	bool CompactSdp::Deserialize(const char* data, size_t size, RtcCompactDescription* out)
+	{
+		rtc::ByteBufferReader reader(data, size);
+
+		uint8_t magic, version, type, role;
+		if (!reader.ReadUInt8(&magic) || magic != kMagic ||
+			!reader.ReadUInt8(&version) || version != kVersion ||
+			!reader.ReadUInt8(&type) || type > static_cast<uint8_t>(webrtc::SdpType::kAnswer) ||
+			!reader.ReadUInt8(&role) || role > cricket::CONNECTIONROLE_HOLDCONN)
+		{
+			return false;
+		}
+
+		out->type = webrtc::SdpTypeToString(static_cast<webrtc::SdpType>(type));
+		out->setup.clear();
+		cricket::ConnectionRoleToString(static_cast<cricket::ConnectionRole>(role), &out->setup);
+
+		uint16_t port;
+		uint32_t maxMessageSize;
+		uint8_t count;
+		if (!reader.ReadUInt64(&out->sessionId) ||
+			!ReadShortString(reader, &out->mid) ||
+			!ReadShortString(reader, &out->iceUfrag) ||
+			!ReadShortString(reader, &out->icePwd) ||
+			!ReadShortString(reader, &out->fingerprintAlgorithm) ||
+			!ReadShortString(reader, &out->fingerprint) ||
+			!reader.ReadUInt16(&port) ||
+			!reader.ReadUInt32(&maxMessageSize) ||
+			!reader.ReadUInt8(&count))
+		{
+			return false;
+		}
+		out->sctpPort = port;
+		out->maxMessageSize = static_cast<int>(maxMessageSize);
+
+		out->candidates.clear();
+		for (uint8_t i = 0; i < count; i++)
+		{
+			uint16_t length;
+			std::string candidate;
+			if (!reader.ReadUInt16(&length) || !reader.ReadString(&candidate, length))
+				return false;
+			out->candidates.push_back(candidate);
+		}
+		return true;
+	}
+
+	std::string CompactSdp::ToSdp(const RtcCompactDescription& compact)
+	{
+		rtc::SSLFingerprint fingerprint(compact.fingerprintAlgorithm,
+			reinterpret_cast<const uint8_t*>(compact.fingerprint.data()), compact.fingerprint.size());
+
+		std::string sdp;
+		sdp.reserve(512 + compact.candidates.size() * 96);
+		sdp += "v=0\r\n";
+		sdp += "o=- " + std::to_string(compact.sessionId) + " 2 IN IP4 127.0.0.1\r\n";
+		sdp += "s=-\r\n";
+		sdp += "t=0 0\r\n";
+		sdp += "a=group:BUNDLE " + compact.mid + "\r\n";
+		sdp += "a=msid-semantic: WMS\r\n";
+		sdp += "m=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\n";
+		sdp += "c=IN IP4 0.0.0.0\r\n";
+		for (auto const& candidate : compact.candidates)
+		{
+			sdp += "a=" + candidate + "\r\n";
+		}
+		sdp += "a=ice-ufrag:" + compact.iceUfrag + "\r\n";
+		sdp += "a=ice-pwd:" + compact.icePwd + "\r\n";
+		sdp += "a=ice-options:trickle\r\n";
+		sdp += "a=fingerprint:" + compact.fingerprintAlgorithm + " " + fingerprint.GetRfc4572Fingerprint() + "\r\n";
+		if (!compact.setup.empty())
+			sdp += "a=setup:" + compact.setup + "\r\n";
+		sdp += "a=mid:" + compact.mid + "\r\n";
+		sdp += "a=sctp-port:" + std::to_string(compact.sctpPort) + "\r\n";
+		sdp += "a=max-message-size:" + std::to_string(compact.maxMessageSize) + "\r\n";
+		return sdp;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "api/jsep.h"
+
+namespace Spitfire
+{
+	// Everything a data channel only session needs from its SDP.
+	struct RtcCompactDescription
+	{
+		std::string type;
+		uint64_t sessionId = 0;
+		std::string mid;
+		std::string iceUfrag;
+		std::string icePwd;
+		std::string fingerprintAlgorithm;
+		std::string fingerprint;
+		std::string setup;
+		int sctpPort = 5000;
+		int maxMessageSize = 64 * 1024;
+		// Candidate attributes without the "a=" prefix.
+		std::vector<std::string> candidates;
+	};
+
+	// Converts data channel only session descriptions to and from a small binary
+	// form for signaling. The SDP text is rebuilt from the struct only where
+	// libwebrtc needs it, instead of being sent over the wire.
+	class CompactSdp
+	{
+	public:
+		static const uint8_t kMagic = 0x53;
+		static const uint8_t kVersion = 1;
+
+		// Returns false when |desc| carries anything besides one SCTP section.
+		static bool FromDescription(const webrtc::SessionDescriptionInterface* desc, RtcCompactDescription* out);
+
+		// Returns false when a field does not fit the binary form or the type is not an offer or answer,
+		// the description then has to go out as SDP.
+		static bool Serialize(const RtcCompactDescription& compact, std::string* out);
+		static bool Deserialize(const char* data, size_t size, RtcCompactDescription* out);
+
+		static std::string ToSdp(const RtcCompactDescription& compact);
+	};
+}
@@ -1,12 +1,33 @@
 #include "CreateSessionDescriptionObserver.h"
 #include "RtcConductor.h"
+#include "CompactSdp.h"
 
 void Spitfire::Observers::CreateSessionDescriptionObserver::OnSuccess(webrtc::SessionDescriptionInterface * desc)
 {
+	if (completion_)
+	{
+		completion_(desc, std::string());
+		return;
+	}
 	if (!conductor_->peerObserver->peerConnection.get())
 	{
 		return;
 	}
+	conductor_->OnLocalDescriptionCreated(desc);
+
+	// Data channel only sessions skip SDP text entirely when compact signaling is on,
+	// anything that does not fit the binary form goes out as SDP.
+	Spitfire::RtcCompactDescription compact;
+	std::string data;
+	if (conductor_->IsCompactSignaling() && conductor_->onCompactSuccess &&
+		Spitfire::CompactSdp::FromDescription(desc, &compact) && Spitfire::CompactSdp::Serialize(compact, &data))
+	{
+		const std::string type = desc->type();
+		conductor_->peerObserver->peerConnection->SetLocalDescription(conductor_->setSessionObserver.get(), desc);
+		conductor_->onCompactSuccess(type.c_str(), reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+		return;
+	}
+
 	conductor_->peerObserver->peerConnection->SetLocalDescription(conductor_->setSessionObserver.get(), desc);
 	std::string sdp;
 	desc->ToString(&sdp);
@@ -19,6 +40,11 @@ void Spitfire::Observers::CreateSessionDescriptionObserver::OnSuccess(webrtc::Se
 void Spitfire::Observers::CreateSessionDescriptionObserver::OnFailure(const std::string & error)
 {
 	RTC_LOG(LERROR) << error;
+	if (completion_)
+	{
+		completion_(nullptr, error);
+		return;
+	}
 	if (conductor_->onFailure)
 	{
 		conductor_->onFailure(error.c_str());
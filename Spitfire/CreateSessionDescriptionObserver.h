@@ -3,6 +3,8 @@
 #include "api/peer_connection_interface.h"
 #include "api/jsep.h"
 
+#include <functional>
+
 namespace Spitfire 
 {
 	class RtcConductor;
@@ -12,10 +14,19 @@ namespace Spitfire
 		class CreateSessionDescriptionObserver : public webrtc::CreateSessionDescriptionObserver
 		{
 		public:
+			// Receives the created description, or null and the error.
+			typedef std::function<void(webrtc::SessionDescriptionInterface * desc, const std::string & error)> Completion;
+
 			explicit CreateSessionDescriptionObserver(RtcConductor* conductor) :
 				conductor_(conductor)
 			{
 			}
+			// Hands the result to |completion| instead of the conductor's callbacks.
+			CreateSessionDescriptionObserver(RtcConductor* conductor, Completion completion) :
+				conductor_(conductor),
+				completion_(std::move(completion))
+			{
+			}
 			~CreateSessionDescriptionObserver() = default;
 
 			void OnSuccess(webrtc::SessionDescriptionInterface * desc) override;
@@ -38,6 +49,7 @@ namespace Spitfire
 		private:
 			mutable webrtc::webrtc_impl::RefCounter ref_count_{ 0 };
 			RtcConductor* conductor_;
+			Completion completion_;
 		};
 	}
 }
\ No newline at end of file
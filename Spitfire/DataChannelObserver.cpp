@@ -1,5 +1,9 @@
 #include "DataChannelObserver.h"
 #include "RtcConductor.h"
+#include "absl/types/optional.h"
+#include "rtc_base/logging.h"
+
+#include <algorithm>
 
 void Spitfire::Observers::DataChannelObserver::OnStateChange()
 {
@@ -12,6 +16,7 @@ void Spitfire::Observers::DataChannelObserver::OnStateChange()
 
 void Spitfire::Observers::DataChannelObserver::OnBufferedAmountChange(uint64_t previous_amount)
 {
+	TopicRegistry::Instance().OnBufferedAmountChange(conductor_, dataChannel->label());
 	if (conductor_->onBufferAmountChange)
 	{
 		conductor_->onBufferAmountChange(dataChannel->label().c_str(), previous_amount, dataChannel->buffered_amount(), dataChannel->bytes_sent(), dataChannel->bytes_received());
@@ -19,13 +24,63 @@ void Spitfire::Observers::DataChannelObserver::OnBufferedAmountChange(uint64_t p
 }
 
 void Spitfire::Observers::DataChannelObserver::OnMessage(const webrtc::DataBuffer & buffer)
+{
+	const auto label = dataChannel->label();
+	const bool relayed = DataChannelRelay::Instance().Forward(conductor_, label, buffer);
+	const bool published = TopicRegistry::Instance().OnMessage(conductor_, label, buffer);
+	if (relayed || published)
+	{
+		return;
+	}
+
+	bool direct = false;
+	bool paused = false;
+	bool overflowed = false;
+	{
+		rtc::CritScope lock(&crit_);
+		direct = mode_ == RtcReceiveMode::Callback && window_ == 0 && pending_.empty();
+		if (!direct && (overflowed_ || pendingBytes_ + buffer.size() > kMaxPendingBytes))
+		{
+			overflowed = !overflowed_;
+			overflowed_ = true;
+		}
+		else if (!direct)
+		{
+			pending_.push_back(buffer);
+			pendingBytes_ += buffer.size();
+			if (mode_ == RtcReceiveMode::Batched && window_ > 0 && pendingBytes_ >= window_ && !paused_)
+			{
+				paused_ = paused = true;
+			}
+		}
+	}
+
+	if (overflowed)
+	{
+		CloseOverflowed();
+	}
+	else if (direct)
+	{
+		Deliver(label, buffer);
+	}
+	else if (paused)
+	{
+		NotifyWindow(true);
+	}
+	else
+	{
+		DeliverPending();
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::Deliver(const std::string& label, const webrtc::DataBuffer & buffer)
 {
 	if (buffer.binary)
 	{
 		if (conductor_->onDataBinaryMessage)
 		{
 			auto * data = buffer.data.data();
-			conductor_->onDataBinaryMessage(dataChannel->label().c_str(), data, static_cast<uint32_t>(buffer.size()));
+			conductor_->onDataBinaryMessage(label.c_str(), data, static_cast<uint32_t>(buffer.size()));
 		}
 	}
 	else
@@ -33,7 +88,148 @@ void Spitfire::Observers::DataChannelObserver::OnMessage(const webrtc::DataBuffe
 		if (conductor_->onDataMessage)
 		{
 			std::string msg(buffer.data.data<char>(), buffer.size());
-			conductor_->onDataMessage(dataChannel->label().c_str(), msg.c_str());
+			conductor_->onDataMessage(label.c_str(), msg.c_str());
+		}
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::DeliverPending()
+{
+	const auto label = dataChannel->label();
+	for (;;)
+	{
+		absl::optional<webrtc::DataBuffer> next;
+		bool paused = false;
+		bool resumed = false;
+		{
+			rtc::CritScope lock(&crit_);
+			if (mode_ != RtcReceiveMode::Callback)
+				return;
+
+			if (window_ > 0 && unacknowledgedBytes_ >= window_)
+			{
+				paused = !paused_;
+				paused_ = true;
+			}
+			else if (!pending_.empty())
+			{
+				next.emplace(std::move(pending_.front()));
+				pending_.pop_front();
+				pendingBytes_ -= next->size();
+				if (window_ > 0)
+					unacknowledgedBytes_ += next->size();
+			}
+			else
+			{
+				resumed = paused_;
+				paused_ = false;
+			}
+		}
+
+		if (paused || resumed)
+		{
+			NotifyWindow(paused);
+		}
+		if (!next)
+		{
+			return;
+		}
+		Deliver(label, *next);
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::NotifyWindow(bool paused)
+{
+	rtc::Thread* thread = conductor_->SignalingThread();
+	if (thread && !thread->IsCurrent())
+	{
+		thread->PostTask(RTC_FROM_HERE, [this, paused]() { NotifyWindow(paused); });
+		return;
+	}
+
+	if (conductor_->onDataChannelReceiveWindow)
+	{
+		uint64_t pending = 0;
+		{
+			rtc::CritScope lock(&crit_);
+			pending = pendingBytes_;
 		}
+		conductor_->onDataChannelReceiveWindow(dataChannel->label().c_str(), paused, pending);
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::CloseOverflowed()
+{
+	RTC_LOG(LS_WARNING) << "Data channel " << dataChannel->label() << " exceeded " << kMaxPendingBytes << " held bytes, closing";
+	NotifyWindow(true);
+
+	// Not closed from inside the SCTP receive callback.
+	rtc::scoped_refptr<webrtc::DataChannelInterface> channel = dataChannel;
+	rtc::Thread* thread = conductor_->SignalingThread();
+	if (thread)
+	{
+		thread->PostTask(RTC_FROM_HERE, [channel]() { channel->Close(); });
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::SetReceiveWindow(RtcReceiveMode mode, uint64_t window)
+{
+	{
+		rtc::CritScope lock(&crit_);
+		mode_ = mode;
+		window_ = window;
+		unacknowledgedBytes_ = 0;
+	}
+
+	// Anything held back under the previous settings is released on the signaling thread.
+	rtc::Thread* thread = conductor_->SignalingThread();
+	if (mode == RtcReceiveMode::Callback && thread)
+	{
+		thread->PostTask(RTC_FROM_HERE, [this]() { DeliverPending(); });
+	}
+}
+
+void Spitfire::Observers::DataChannelObserver::Acknowledge(uint64_t bytes)
+{
+	{
+		rtc::CritScope lock(&crit_);
+		unacknowledgedBytes_ -= std::min(bytes, unacknowledgedBytes_);
+	}
+
+	rtc::Thread* thread = conductor_->SignalingThread();
+	if (thread)
+	{
+		thread->PostTask(RTC_FROM_HERE, [this]() { DeliverPending(); });
+	}
+}
+
+size_t Spitfire::Observers::DataChannelObserver::Drain(std::vector<webrtc::DataBuffer>& messages, size_t max_messages)
+{
+	size_t drained = 0;
+	bool resumed = false;
+	{
+		rtc::CritScope lock(&crit_);
+		if (mode_ != RtcReceiveMode::Batched)
+			return 0;
+
+		while (!pending_.empty() && drained < max_messages)
+		{
+			pendingBytes_ -= pending_.front().size();
+			messages.push_back(std::move(pending_.front()));
+			pending_.pop_front();
+			drained++;
+		}
+
+		if (paused_ && (window_ == 0 || pendingBytes_ < window_))
+		{
+			paused_ = false;
+			resumed = true;
+		}
+	}
+
+	if (resumed)
+	{
+		NotifyWindow(false);
 	}
+	return drained;
 }
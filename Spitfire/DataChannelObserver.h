@@ -2,11 +2,23 @@
 
 #include "api/peer_connection_interface.h"
 #include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+
+#include <deque>
+#include <vector>
 
 namespace Spitfire 
 {
 	class RtcConductor;
 
+	enum class RtcReceiveMode
+	{
+		// Messages are pushed to the application through onDataMessage/onDataBinaryMessage.
+		Callback,
+		// Messages are held until the application drains them.
+		Batched
+	};
+
 	namespace Observers
 	{
 		class DataChannelObserver : public webrtc::DataChannelObserver
@@ -27,6 +39,21 @@ namespace Spitfire
 			// The data channel's buffered_amount has changed.
 			void OnBufferedAmountChange(uint64_t previous_amount) override;
 
+			// Hard limit on received bytes held natively for one channel. The window only
+			// throttles delivery to the application, it does not touch SCTP flow control,
+			// so a remote that keeps sending is cut off here by closing the channel.
+			static const uint64_t kMaxPendingBytes = 64 * 1024 * 1024;
+
+			// Limits how many received bytes may be outstanding in the application.
+			// A window of zero in callback mode restores unthrottled delivery.
+			void SetReceiveWindow(RtcReceiveMode mode, uint64_t window);
+
+			// Callback mode, the application finished with |bytes| of delivered data.
+			void Acknowledge(uint64_t bytes);
+
+			// Batched mode, moves up to |max_messages| received messages into |messages|.
+			size_t Drain(std::vector<webrtc::DataBuffer>& messages, size_t max_messages);
+
 			rtc::scoped_refptr<webrtc::DataChannelInterface> dataChannel;
 			//gcroot<WebRtcInterop::RtcDataChannel ^> _dataChannel;
 			//rtc::scoped_refptr<webrtc::DataChannelInterface> _nativeDataChannel;
@@ -41,7 +68,21 @@ namespace Spitfire
 			};
 
 		private:
+			void Deliver(const std::string& label, const webrtc::DataBuffer& buffer);
+			void DeliverPending();
+			void NotifyWindow(bool paused);
+			void CloseOverflowed();
+
 			RtcConductor* conductor_;
+
+			rtc::CriticalSection crit_;
+			RtcReceiveMode mode_ = RtcReceiveMode::Callback;
+			uint64_t window_ = 0;
+			std::deque<webrtc::DataBuffer> pending_;
+			uint64_t pendingBytes_ = 0;
+			uint64_t unacknowledgedBytes_ = 0;
+			bool paused_ = false;
+			bool overflowed_ = false;
 		};
 	}
 }
\ No newline at end of file
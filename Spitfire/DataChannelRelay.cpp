@@ -0,0 +1,187 @@
+#include "DataChannelRelay.h"
+#include "RtcConductor.h"
+
+namespace Spitfire
+{
+	DataChannelRelay& DataChannelRelay::Instance()
+	{
+		static DataChannelRelay* const relay = new DataChannelRelay();
+		return *relay;
+	}
+
+	std::shared_ptr<DataChannelRelay::Route> DataChannelRelay::FindRoute(const ChannelKey& key, RtcConductor* destination, const std::string& destinationLabel)
+	{
+		auto source = sources_.find(key);
+		if (source == sources_.end())
+			return nullptr;
+
+		for (auto const& route : source->second.routes)
+		{
+			if (route->destination == destination && route->label == destinationLabel)
+				return route;
+		}
+		return nullptr;
+	}
+
+	void DataChannelRelay::AddRoute(RtcConductor* source, const std::string& label, RtcConductor* destination, const std::string& destinationLabel)
+	{
+		RTC_DCHECK(source && destination);
+		rtc::CritScope lock(&crit_);
+
+		const ChannelKey key(source, label);
+		if (FindRoute(key, destination, destinationLabel))
+			return;
+
+		auto route = std::make_shared<Route>();
+		route->destination = destination;
+		route->label = destinationLabel;
+		route->thread = destination->SignalingThread();
+		route->channel = destination->GetDataChannel(destinationLabel);
+		sources_[key].routes.push_back(route);
+		routeCount_++;
+	}
+
+	void DataChannelRelay::RemoveRoute(RtcConductor* source, const std::string& label, RtcConductor* destination, const std::string& destinationLabel)
+	{
+		rtc::CritScope lock(&crit_);
+
+		auto it = sources_.find(ChannelKey(source, label));
+		if (it == sources_.end())
+			return;
+
+		auto& routes = it->second.routes;
+		for (auto route = routes.begin(); route != routes.end(); ++route)
+		{
+			if ((*route)->destination == destination && (*route)->label == destinationLabel)
+			{
+				routes.erase(route);
+				routeCount_--;
+				break;
+			}
+		}
+		if (routes.empty() && !it->second.forwardOnly)
+			sources_.erase(it);
+	}
+
+	void DataChannelRelay::SetForwardOnly(RtcConductor* source, const std::string& label, bool forwardOnly)
+	{
+		rtc::CritScope lock(&crit_);
+
+		// Kept without routes, so the flag still holds when a route is added again.
+		const ChannelKey key(source, label);
+		if (forwardOnly)
+		{
+			sources_[key].forwardOnly = true;
+			return;
+		}
+
+		auto it = sources_.find(key);
+		if (it == sources_.end())
+			return;
+		it->second.forwardOnly = false;
+		if (it->second.routes.empty())
+			sources_.erase(it);
+	}
+
+	RtcDataChannelRouteInfo DataChannelRelay::GetRouteInfo(RtcConductor* source, const std::string& label, RtcConductor* destination, const std::string& destinationLabel)
+	{
+		auto info = RtcDataChannelRouteInfo();
+		rtc::CritScope lock(&crit_);
+
+		auto route = FindRoute(ChannelKey(source, label), destination, destinationLabel);
+		if (route)
+		{
+			info.messagesForwarded = route->messagesForwarded;
+			info.bytesForwarded = route->bytesForwarded;
+			info.messagesDropped = route->messagesDropped;
+		}
+		return info;
+	}
+
+	void DataChannelRelay::OnDataChannel(RtcConductor* conductor, const std::string& label, rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
+	{
+		if (routeCount_ == 0)
+			return;
+
+		rtc::CritScope lock(&crit_);
+		for (auto const& source : sources_)
+		{
+			for (auto const& route : source.second.routes)
+			{
+				if (route->destination == conductor && route->label == label)
+				{
+					route->thread = conductor->SignalingThread();
+					route->channel = channel;
+				}
+			}
+		}
+	}
+
+	bool DataChannelRelay::Forward(RtcConductor* source, const std::string& label, const webrtc::DataBuffer& buffer)
+	{
+		if (routeCount_ == 0)
+			return false;
+
+		rtc::CritScope lock(&crit_);
+		auto it = sources_.find(ChannelKey(source, label));
+		if (it == sources_.end())
+			return false;
+
+		for (auto const& route : it->second.routes)
+		{
+			if (!route->thread || !route->channel)
+			{
+				route->messagesDropped++;
+				continue;
+			}
+
+			// The destination channel belongs to its own signaling thread, posting
+			// there lets the proxy call straight through instead of blocking us.
+			std::shared_ptr<Route> target = route;
+			rtc::scoped_refptr<webrtc::DataChannelInterface> channel = route->channel;
+			route->thread->PostTask(RTC_FROM_HERE, [target, channel, buffer]()
+			{
+				if (channel->state() != webrtc::DataChannelInterface::kOpen ||
+					channel->buffered_amount() > kMaxBufferedAmount ||
+					!channel->Send(buffer))
+				{
+					target->messagesDropped++;
+					return;
+				}
+				target->messagesForwarded++;
+				target->bytesForwarded += buffer.size();
+			});
+		}
+		// Nothing relayed, the application still gets the message.
+		return it->second.forwardOnly && !it->second.routes.empty();
+	}
+
+	void DataChannelRelay::RemoveConductor(RtcConductor* conductor)
+	{
+		if (routeCount_ == 0)
+			return;
+
+		rtc::CritScope lock(&crit_);
+		for (auto it = sources_.begin(); it != sources_.end();)
+		{
+			auto& routes = it->second.routes;
+			for (auto route = routes.begin(); route != routes.end();)
+			{
+				if (it->first.first == conductor || (*route)->destination == conductor)
+				{
+					route = routes.erase(route);
+					routeCount_--;
+				}
+				else
+				{
+					++route;
+				}
+			}
+
+			if (it->first.first == conductor || (routes.empty() && !it->second.forwardOnly))
+				it = sources_.erase(it);
+			else
+				++it;
+		}
+	}
+}
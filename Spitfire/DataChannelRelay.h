@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+
+namespace Spitfire
+{
+	class RtcConductor;
+
+	struct RtcDataChannelRouteInfo
+	{
+		uint64_t messagesForwarded;
+		uint64_t bytesForwarded;
+		uint64_t messagesDropped;
+	};
+
+	// Forwards messages received on one peer's data channel to data channels
+	// on other peers without leaving native code. The received CopyOnWriteBuffer
+	// is shared with every destination, so a fan-out never copies the payload.
+	class DataChannelRelay
+	{
+	public:
+		// Destinations with more than this queued are skipped instead of
+		// growing their send buffer until the channel closes itself.
+		static const uint64_t kMaxBufferedAmount = 8 * 1024 * 1024;
+
+		static DataChannelRelay& Instance();
+
+		void AddRoute(RtcConductor* source, const std::string& label, RtcConductor* destination, const std::string& destinationLabel);
+		void RemoveRoute(RtcConductor* source, const std::string& label, RtcConductor* destination, const std::string& destinationLabel);
+		void SetForwardOnly(RtcConductor* source, const std::string& label, bool forwardOnly);
+		RtcDataChannelRouteInfo GetRouteInfo(RtcConductor* source, const std::string& label, RtcConductor* destination, const std::string& destinationLabel);
+
+		// Binds routes that were added before the destination channel existed.
+		void OnDataChannel(RtcConductor* conductor, const std::string& label, rtc::scoped_refptr<webrtc::DataChannelInterface> channel);
+
+		// Sends |buffer| on every route leaving (source, label). Returns true when
+		// the message must not be delivered to the application as well.
+		bool Forward(RtcConductor* source, const std::string& label, const webrtc::DataBuffer& buffer);
+
+		// Drops every route that starts or ends at |conductor|.
+		void RemoveConductor(RtcConductor* conductor);
+
+	private:
+		struct Route
+		{
+			RtcConductor* destination;
+			std::string label;
+			rtc::Thread* thread;
+			rtc::scoped_refptr<webrtc::DataChannelInterface> channel;
+
+			std::atomic<uint64_t> messagesForwarded{ 0 };
+			std::atomic<uint64_t> bytesForwarded{ 0 };
+			std::atomic<uint64_t> messagesDropped{ 0 };
+		};
+
+		struct Source
+		{
+			bool forwardOnly = false;
+			std::vector<std::shared_ptr<Route>> routes;
+		};
+
+		typedef std::pair<RtcConductor*, std::string> ChannelKey;
+
+		DataChannelRelay() = default;
+
+		std::shared_ptr<Route> FindRoute(const ChannelKey& key, RtcConductor* destination, const std::string& destinationLabel);
+
+		rtc::CriticalSection crit_;
+		std::map<ChannelKey, Source> sources_;
+		std::atomic<int> routeCount_{ 0 };
+	};
+}
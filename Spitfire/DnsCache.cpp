@@ -0,0 +1,333 @@
+#include "DnsCache.h"
+
+#include <algorithm>
+
+#include "rtc_base/logging.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/time_utils.h"
+
+#if defined(WEBRTC_WIN)
+#include <ws2tcpip.h>
+#include <windns.h>
+#else
+#include <netdb.h>
+#endif
+
+namespace Spitfire
+{
+	namespace
+	{
+		// Remaining TTL of the records the system resolver just cached for |hostname|,
+		// -1 where the OS does not tell.
+		int64_t RecordTtlMs(const std::string& hostname)
+		{
+#if defined(WEBRTC_WIN)
+			DWORD ttl = MAXDWORD;
+			for (WORD type : { DNS_TYPE_A, DNS_TYPE_AAAA })
+			{
+				PDNS_RECORD records = nullptr;
+				if (DnsQuery_UTF8(hostname.c_str(), type, DNS_QUERY_NO_WIRE_QUERY, nullptr, &records, nullptr) != ERROR_SUCCESS)
+					continue;
+
+				for (PDNS_RECORD record = records; record; record = record->pNext)
+				{
+					if (record->wType == type)
+						ttl = std::min(ttl, record->dwTtl);
+				}
+				DnsRecordListFree(records, DnsFreeRecordList);
+			}
+			if (ttl != MAXDWORD)
+				return static_cast<int64_t>(ttl) * 1000;
+#endif
+			return -1;
+		}
+
+		class CachedResolverFactory : public webrtc::AsyncResolverFactory
+		{
+		public:
+			rtc::AsyncResolverInterface* Create() override
+			{
+				rtc::AsyncResolverInterface* resolver = DnsCache::Instance().CreateResolver();
+				return resolver ? resolver : new rtc::AsyncResolver();
+			}
+		};
+	}
+
+	DnsCache& DnsCache::Instance()
+	{
+		static DnsCache* const cache = new DnsCache();
+		return *cache;
+	}
+
+	void DnsCache::Start()
+	{
+		rtc::CritScope lock(&crit_);
+		if (thread_)
+			return;
+
+		thread_ = rtc::Thread::Create();
+		thread_->SetName("spitfire_dns", nullptr);
+		thread_->Start();
+		thread_->PostDelayedTask(webrtc::ToQueuedTask([this]() { Sweep(); }), kSweepIntervalMs);
+	}
+
+	void DnsCache::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+		}
+		if (!thread)
+			return;
+
+		// Lookups still running are abandoned, their waiters fail below.
+		thread->Invoke<void>(RTC_FROM_HERE, [this]()
+		{
+			for (auto const& lookup : inFlight_)
+			{
+				lookup.first->Destroy(false);
+			}
+			inFlight_.clear();
+		});
+		thread->Stop();
+		Clear();
+	}
+
+	bool DnsCache::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return thread_ != nullptr;
+	}
+
+	void DnsCache::SetTtl(int max_ttl_seconds, int negative_ttl_seconds)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			maxTtlMs_ = std::max(0, max_ttl_seconds) * 1000;
+			negativeTtlMs_ = std::max(0, negative_ttl_seconds) * 1000;
+		}
+		Clear();
+	}
+
+	void DnsCache::Clear()
+	{
+		rtc::CritScope lock(&crit_);
+		// A lookup still running finds no entry and is thrown away, its waiters fail now.
+		for (auto const& entry : entries_)
+		{
+			for (auto const& waiter : entry.second.waiters)
+			{
+				Publish(waiter, std::vector<rtc::IPAddress>(), EAI_FAIL);
+			}
+		}
+		entries_.clear();
+	}
+
+	rtc::AsyncResolverInterface* DnsCache::CreateResolver()
+	{
+		if (!IsRunning())
+			return nullptr;
+		return new CachedResolver(this);
+	}
+
+	std::unique_ptr<webrtc::AsyncResolverFactory> DnsCache::CreateResolverFactory()
+	{
+		if (!IsRunning())
+			return nullptr;
+		return std::unique_ptr<webrtc::AsyncResolverFactory>(new CachedResolverFactory());
+	}
+
+	void DnsCache::Resolve(const std::string& hostname, const std::shared_ptr<Waiter>& waiter)
+	{
+		rtc::CritScope lock(&crit_);
+		queries_++;
+
+		auto entry = entries_.find(hostname);
+		if (entry != entries_.end() && !entry->second.pending && entry->second.expiresMs <= rtc::TimeMillis())
+		{
+			entries_.erase(entry);
+			entry = entries_.end();
+		}
+
+		if (entry == entries_.end())
+		{
+			if (!thread_)
+			{
+				Publish(waiter, std::vector<rtc::IPAddress>(), EAI_FAIL);
+				return;
+			}
+
+			entries_[hostname].waiters.push_back(waiter);
+			lookups_++;
+			thread_->PostTask(RTC_FROM_HERE, [this, hostname]()
+			{
+				Lookup(hostname);
+			});
+			return;
+		}
+
+		if (entry->second.pending)
+			entry->second.waiters.push_back(waiter);
+		else
+			Publish(waiter, entry->second.addresses, entry->second.error);
+	}
+
+	void DnsCache::Cancel(const std::string& hostname, const std::shared_ptr<Waiter>& waiter)
+	{
+		rtc::CritScope lock(&crit_);
+		auto entry = entries_.find(hostname);
+		if (entry == entries_.end())
+			return;
+
+		auto& waiters = entry->second.waiters;
+		waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+	}
+
+	void DnsCache::Lookup(const std::string& hostname)
+	{
+		// Each name gets its own worker, a slow one only delays its own waiters.
+		auto resolver = new rtc::AsyncResolver();
+		resolver->SignalDone.connect(this, &DnsCache::OnLookupDone);
+		inFlight_[resolver] = hostname;
+		resolver->Start(rtc::SocketAddress(hostname, 0));
+	}
+
+	void DnsCache::OnLookupDone(rtc::AsyncResolverInterface* done)
+	{
+		auto lookup = inFlight_.find(static_cast<rtc::AsyncResolver*>(done));
+		if (lookup == inFlight_.end())
+			return;
+
+		const std::string hostname = lookup->second;
+		int error = lookup->first->GetError();
+		std::vector<rtc::IPAddress> addresses = error == 0 ? lookup->first->addresses() : std::vector<rtc::IPAddress>();
+		if (error == 0 && addresses.empty())
+			error = EAI_NONAME;
+		lookup->first->Destroy(false);
+		inFlight_.erase(lookup);
+
+		const int64_t ttlMs = error == 0 ? RecordTtlMs(hostname) : -1;
+
+		rtc::CritScope lock(&crit_);
+		auto entry = entries_.find(hostname);
+		if (entry == entries_.end())
+			return;
+
+		if (error != 0)
+		{
+			RTC_LOG(WARNING) << "Could not resolve " << hostname << ": " << error;
+			failures_++;
+		}
+		const int64_t keepMs = error != 0 ? negativeTtlMs_ : ttlMs >= 0 ? std::min<int64_t>(ttlMs, maxTtlMs_) : maxTtlMs_;
+
+		entry->second.pending = false;
+		entry->second.addresses = addresses;
+		entry->second.error = error;
+		entry->second.expiresMs = rtc::TimeMillis() + keepMs;
+		for (auto const& waiter : entry->second.waiters)
+		{
+			Publish(waiter, addresses, error);
+		}
+		entry->second.waiters.clear();
+	}
+
+	void DnsCache::Sweep()
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			const int64_t now = rtc::TimeMillis();
+			for (auto it = entries_.begin(); it != entries_.end();)
+			{
+				if (!it->second.pending && it->second.expiresMs <= now)
+					it = entries_.erase(it);
+				else
+					++it;
+			}
+		}
+		rtc::Thread::Current()->PostDelayedTask(webrtc::ToQueuedTask([this]() { Sweep(); }), kSweepIntervalMs);
+	}
+
+	void DnsCache::Publish(const std::shared_ptr<Waiter>& waiter, const std::vector<rtc::IPAddress>& addresses, int error)
+	{
+		// Ports expect SignalDone after Start returned, so even cache hits are posted.
+		std::shared_ptr<Waiter> target = waiter;
+		std::vector<rtc::IPAddress> result = addresses;
+		waiter->thread->PostTask(RTC_FROM_HERE, [target, result, error]()
+		{
+			if (target->resolver)
+				target->resolver->OnResolved(result, error);
+		});
+	}
+
+	RtcDnsCacheInfo DnsCache::GetInfo()
+	{
+		auto info = RtcDnsCacheInfo();
+		rtc::CritScope lock(&crit_);
+
+		info.entries = static_cast<uint32_t>(entries_.size());
+		info.queries = queries_;
+		info.lookups = lookups_;
+		info.failures = failures_;
+		return info;
+	}
+
+	CachedResolver::CachedResolver(DnsCache* cache) :
+		cache_(cache)
+	{
+	}
+
+	void CachedResolver::Start(const rtc::SocketAddress& addr)
+	{
+		addr_ = addr;
+		waiter_ = std::make_shared<DnsCache::Waiter>();
+		waiter_->thread = rtc::Thread::Current();
+		waiter_->resolver = this;
+
+		rtc::IPAddress ip;
+		if (rtc::IPFromString(addr.hostname(), &ip))
+			cache_->Publish(waiter_, std::vector<rtc::IPAddress>(1, ip), 0);
+		else
+			cache_->Resolve(addr.hostname(), waiter_);
+	}
+
+	bool CachedResolver::GetResolvedAddress(int family, rtc::SocketAddress* addr) const
+	{
+		if (error_ != 0)
+			return false;
+
+		*addr = addr_;
+		for (auto const& ip : addresses_)
+		{
+			if (ip.family() == family)
+			{
+				addr->SetResolvedIP(ip);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int CachedResolver::GetError() const
+	{
+		return error_;
+	}
+
+	void CachedResolver::Destroy(bool wait)
+	{
+		// Results are posted to this thread, a cleared waiter drops the ones still queued.
+		if (waiter_)
+		{
+			waiter_->resolver = nullptr;
+			cache_->Cancel(addr_.hostname(), waiter_);
+		}
+		delete this;
+	}
+
+	void CachedResolver::OnResolved(const std::vector<rtc::IPAddress>& addresses, int error)
+	{
+		addresses_ = addresses;
+		error_ = error;
+		SignalDone(this);
+	}
+}
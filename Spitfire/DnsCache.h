@@ -0,0 +1,122 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/async_resolver_factory.h"
+#include "rtc_base/async_resolver_interface.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/ip_address.h"
+#include "rtc_base/net_helpers.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+namespace Spitfire
+{
+	class CachedResolver;
+
+	struct RtcDnsCacheInfo
+	{
+		uint32_t entries;
+		// Resolutions asked for by ports, and the ones that needed a lookup.
+		uint64_t queries;
+		uint64_t lookups;
+		uint64_t failures;
+	};
+
+	// Resolves STUN and TURN server names once for the whole process. Every port
+	// allocator gathering at the same time joins the lookup in flight, later ones are
+	// answered from the cache until the record's TTL runs out. Failures are cached too,
+	// for a shorter time, so an unreachable name is not retried by every peer. Each name
+	// resolves on its own, one slow name does not hold up the others.
+	class DnsCache : public sigslot::has_slots<>
+	{
+	public:
+		static const int kDefaultMaxTtlSeconds = 300;
+		static const int kDefaultNegativeTtlSeconds = 10;
+		// How often expired records are dropped when nobody asks for them again.
+		static const int kSweepIntervalMs = 30 * 1000;
+
+		static DnsCache& Instance();
+
+		void Start();
+		void Stop();
+		bool IsRunning() const;
+
+		// Records are kept for their TTL, at most |max_ttl_seconds|. Clears the cache.
+		void SetTtl(int max_ttl_seconds, int negative_ttl_seconds);
+		void Clear();
+
+		// Null when not running. Resolvers are used and destroyed on the thread that starts them.
+		rtc::AsyncResolverInterface* CreateResolver();
+		std::unique_ptr<webrtc::AsyncResolverFactory> CreateResolverFactory();
+		RtcDnsCacheInfo GetInfo();
+
+	private:
+		friend class CachedResolver;
+
+		struct Waiter
+		{
+			rtc::Thread* thread;
+			// Only touched on |thread|.
+			CachedResolver* resolver;
+		};
+
+		struct Entry
+		{
+			bool pending = true;
+			std::vector<rtc::IPAddress> addresses;
+			int error = 0;
+			int64_t expiresMs = 0;
+			std::vector<std::shared_ptr<Waiter>> waiters;
+		};
+
+		DnsCache() = default;
+
+		void Resolve(const std::string& hostname, const std::shared_ptr<Waiter>& waiter);
+		void Cancel(const std::string& hostname, const std::shared_ptr<Waiter>& waiter);
+		// Run on |thread_|, the lookup itself runs on an rtc::AsyncResolver worker.
+		void Lookup(const std::string& hostname);
+		void OnLookupDone(rtc::AsyncResolverInterface* resolver);
+		void Sweep();
+		void Publish(const std::shared_ptr<Waiter>& waiter, const std::vector<rtc::IPAddress>& addresses, int error);
+
+		mutable rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		std::map<std::string, Entry> entries_;
+		// Only touched on |thread_|.
+		std::map<rtc::AsyncResolver*, std::string> inFlight_;
+		int maxTtlMs_ = kDefaultMaxTtlSeconds * 1000;
+		int negativeTtlMs_ = kDefaultNegativeTtlSeconds * 1000;
+
+		uint64_t queries_ = 0;
+		uint64_t lookups_ = 0;
+		uint64_t failures_ = 0;
+	};
+
+	class CachedResolver : public rtc::AsyncResolverInterface
+	{
+	public:
+		explicit CachedResolver(DnsCache* cache);
+
+		void Start(const rtc::SocketAddress& addr) override;
+		bool GetResolvedAddress(int family, rtc::SocketAddress* addr) const override;
+		int GetError() const override;
+		void Destroy(bool wait) override;
+
+	private:
+		friend class DnsCache;
+
+		~CachedResolver() override = default;
+
+		void OnResolved(const std::vector<rtc::IPAddress>& addresses, int error);
+
+		DnsCache* cache_;
+		std::shared_ptr<DnsCache::Waiter> waiter_;
+		rtc::SocketAddress addr_;
+		std::vector<rtc::IPAddress> addresses_;
+		int error_ = 0;
+	};
+}
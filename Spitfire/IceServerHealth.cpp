@@ -0,0 +1,284 @@
+#include "IceServerHealth.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+#include "api/transport/stun.h"
+#include "rtc_base/byte_order.h"
+#include "rtc_base/ip_address.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	namespace
+	{
+		struct ServerUrl
+		{
+			// "stun", or "turn" for turn: and turns: alike.
+			std::string kind;
+			std::string host;
+			std::string port;
+		};
+
+		// Splits "scheme:host:port?transport=..." with an optional bracketed IPv6 host.
+		bool ParseUrl(const std::string& url, ServerUrl* out)
+		{
+			const size_t colon = url.find(':');
+			if (colon == std::string::npos)
+				return false;
+
+			const std::string scheme = url.substr(0, colon);
+			out->kind = scheme == "turns" ? "turn" : scheme;
+
+			const size_t query = url.find('?');
+			const std::string rest = url.substr(colon + 1, query == std::string::npos ? std::string::npos : query - colon - 1);
+			const size_t port = rest.rfind(':');
+			const size_t bracket = rest.find(']');
+			if (port == std::string::npos || (bracket != std::string::npos && port < bracket))
+			{
+				out->host = rest;
+				out->port = scheme == "turns" ? "5349" : "3478";
+			}
+			else
+			{
+				out->host = rest.substr(0, port);
+				out->port = rest.substr(port + 1);
+			}
+			if (out->host.size() > 1 && out->host.front() == '[' && out->host.back() == ']')
+				out->host = out->host.substr(1, out->host.size() - 2);
+			return !out->host.empty();
+		}
+
+		class ProbingSocketFactory : public rtc::PacketSocketFactory
+		{
+		public:
+			ProbingSocketFactory(rtc::PacketSocketFactory* factory, ServerResponseProbe* probe) :
+				factory_(factory),
+				probe_(probe)
+			{
+			}
+
+			rtc::AsyncPacketSocket* CreateUdpSocket(const rtc::SocketAddress& address, uint16_t min_port, uint16_t max_port) override
+			{
+				return Watch(factory_->CreateUdpSocket(address, min_port, max_port));
+			}
+
+			rtc::AsyncPacketSocket* CreateServerTcpSocket(const rtc::SocketAddress& local_address, uint16_t min_port, uint16_t max_port, int opts) override
+			{
+				return factory_->CreateServerTcpSocket(local_address, min_port, max_port, opts);
+			}
+
+			rtc::AsyncPacketSocket* CreateClientTcpSocket(const rtc::SocketAddress& local_address, const rtc::SocketAddress& remote_address,
+				const rtc::ProxyInfo& proxy_info, const std::string& user_agent, const rtc::PacketSocketTcpOptions& tcp_options) override
+			{
+				return Watch(factory_->CreateClientTcpSocket(local_address, remote_address, proxy_info, user_agent, tcp_options));
+			}
+
+			rtc::AsyncResolverInterface* CreateAsyncResolver() override
+			{
+				return factory_->CreateAsyncResolver();
+			}
+
+		private:
+			rtc::AsyncPacketSocket* Watch(rtc::AsyncPacketSocket* socket)
+			{
+				if (socket)
+					probe_->Watch(socket);
+				return socket;
+			}
+
+			rtc::PacketSocketFactory* factory_;
+			ServerResponseProbe* probe_;
+		};
+	}
+
+	IceServerHealth& IceServerHealth::Instance()
+	{
+		static IceServerHealth* const health = new IceServerHealth();
+		return *health;
+	}
+
+	void IceServerHealth::SetPruning(int stall_ms, int retry_ms)
+	{
+		rtc::CritScope lock(&crit_);
+		stallMs_ = std::max(0, stall_ms);
+		retryMs_ = std::max(0, retry_ms);
+		if (stallMs_ == 0)
+			servers_.clear();
+	}
+
+	void IceServerHealth::Record(const std::string& uri, int64_t response_ms)
+	{
+		rtc::CritScope lock(&crit_);
+		if (stallMs_ == 0)
+			return;
+
+		Server& server = servers_[uri];
+		if (response_ms < 0 || response_ms > stallMs_)
+		{
+			// Still stalled on its probe round, it goes straight back out.
+			if (++server.stalls >= kStallsToPrune)
+			{
+				if (server.prunedUntilMs == 0)
+					RTC_LOG(WARNING) << "Pruning stalled ICE server " << uri;
+				server.prunedUntilMs = rtc::TimeMillis() + retryMs_;
+			}
+			return;
+		}
+
+		server.stalls = 0;
+		server.prunedUntilMs = 0;
+		server.smoothedMs = server.smoothedMs < 0 ? response_ms : (server.smoothedMs * 7 + response_ms) / 8;
+	}
+
+	bool IceServerHealth::IsPruned(const std::string& uri)
+	{
+		rtc::CritScope lock(&crit_);
+		if (stallMs_ == 0)
+			return false;
+
+		auto server = servers_.find(uri);
+		if (server == servers_.end() || server->second.prunedUntilMs <= rtc::TimeMillis())
+			return false;
+
+		skipped_++;
+		return true;
+	}
+
+	std::string IceServerHealth::MatchServer(const std::vector<std::string>& uris, const std::string& url)
+	{
+		ServerUrl candidate;
+		if (!ParseUrl(url, &candidate))
+			return std::string();
+
+		std::string byPort;
+		int samePort = 0;
+		for (auto const& uri : uris)
+		{
+			ServerUrl server;
+			if (!ParseUrl(uri, &server) || server.kind != candidate.kind || server.port != candidate.port)
+				continue;
+			if (server.host == candidate.host)
+				return uri;
+
+			rtc::IPAddress ip;
+			if (!rtc::IPFromString(server.host, &ip))
+			{
+				byPort = uri;
+				samePort++;
+			}
+		}
+		return samePort == 1 ? byPort : std::string();
+	}
+
+	bool IceServerHealth::IsEnabled()
+	{
+		rtc::CritScope lock(&crit_);
+		return stallMs_ > 0;
+	}
+
+	RtcIceServerHealthInfo IceServerHealth::GetInfo()
+	{
+		auto info = RtcIceServerHealthInfo();
+		rtc::CritScope lock(&crit_);
+
+		const int64_t now = rtc::TimeMillis();
+		info.servers = static_cast<uint32_t>(servers_.size());
+		for (auto const& server : servers_)
+		{
+			if (server.second.prunedUntilMs > now)
+				info.pruned++;
+		}
+		info.skipped = skipped_;
+		return info;
+	}
+
+	std::unique_ptr<rtc::PacketSocketFactory> ServerResponseProbe::WrapFactory(rtc::PacketSocketFactory* factory)
+	{
+		return std::unique_ptr<rtc::PacketSocketFactory>(new ProbingSocketFactory(factory, this));
+	}
+
+	void ServerResponseProbe::Watch(rtc::AsyncPacketSocket* socket)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			if (collected_)
+			{
+				collected_ = false;
+				startMs_ = rtc::TimeMillis();
+				responses_.clear();
+			}
+		}
+		socket->SignalReadPacket.connect(this, &ServerResponseProbe::OnReadPacket);
+	}
+
+	void ServerResponseProbe::OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size, const rtc::SocketAddress& remote, const int64_t& packet_time_us)
+	{
+		if (size < cricket::kStunHeaderSize || rtc::GetBE32(data + 4) != cricket::kStunMagicCookie)
+			return;
+
+		// Success and error responses alike, a server refusing us still answered.
+		const uint16_t type = rtc::GetBE16(data);
+		if ((type & 0x0100) == 0)
+			return;
+
+		const bool binding = (type & 0x3EEF) == cricket::STUN_BINDING_REQUEST;
+		rtc::CritScope lock(&crit_);
+		responses_.emplace(std::make_pair(std::string(binding ? "stun" : "turn"), remote), rtc::TimeMillis());
+	}
+
+	std::map<std::string, int64_t> ServerResponseProbe::Collect(const std::vector<std::string>& uris)
+	{
+		std::map<std::string, int64_t> result;
+		std::set<std::pair<std::string, rtc::SocketAddress>> literal;
+		std::vector<std::pair<std::string, ServerUrl>> named;
+
+		rtc::CritScope lock(&crit_);
+		collected_ = true;
+		for (auto const& uri : uris)
+		{
+			ServerUrl url;
+			if (!ParseUrl(uri, &url))
+				continue;
+
+			rtc::IPAddress ip;
+			if (!rtc::IPFromString(url.host, &ip))
+			{
+				named.emplace_back(uri, url);
+				continue;
+			}
+
+			const auto key = std::make_pair(url.kind, rtc::SocketAddress(ip, std::atoi(url.port.c_str())));
+			literal.insert(key);
+			auto response = responses_.find(key);
+			result[uri] = response != responses_.end() ? response->second - startMs_ : -1;
+		}
+
+		// Named servers are known by the address they resolved to only through their scheme and port.
+		for (auto const& server : named)
+		{
+			const int port = std::atoi(server.second.port.c_str());
+			int64_t first = -1;
+			for (auto const& response : responses_)
+			{
+				if (response.first.first == server.second.kind && response.first.second.port() == port && literal.count(response.first) == 0 &&
+					(first < 0 || response.second < first))
+				{
+					first = response.second;
+				}
+			}
+
+			const size_t sharing = std::count_if(named.begin(), named.end(), [&server](const std::pair<std::string, ServerUrl>& other)
+			{
+				return other.second.kind == server.second.kind && other.second.port == server.second.port;
+			});
+			if (first < 0)
+				result[server.first] = -1;
+			else if (sharing == 1)
+				result[server.first] = first - startMs_;
+		}
+		return result;
+	}
+}
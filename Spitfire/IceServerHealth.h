@@ -0,0 +1,92 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/packet_socket_factory.h"
+#include "rtc_base/async_packet_socket.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+namespace Spitfire
+{
+	struct RtcIceServerHealthInfo
+	{
+		uint32_t servers;
+		uint32_t pruned;
+		// Times a pruned server was left out of a new peer connection.
+		uint64_t skipped;
+	};
+
+	// Response times of STUN and TURN servers seen across every peer connection. A server
+	// that stalls on consecutive gathering rounds is left out of new peer connections
+	// for a while, then one round probes it again.
+	class IceServerHealth
+	{
+	public:
+		static const int kStallsToPrune = 2;
+		static const int kDefaultRetryMs = 5 * 60 * 1000;
+
+		static IceServerHealth& Instance();
+
+		// Answers slower than |stall_ms| count as a stall, zero turns pruning off.
+		void SetPruning(int stall_ms, int retry_ms);
+
+		// Called once a gathering round is over, |response_ms| is negative when the server never answered.
+		void Record(const std::string& uri, int64_t response_ms);
+		bool IsPruned(const std::string& uri);
+
+		// Which of the configured |uris| a candidate's server url came from, empty if none.
+		// Candidates may carry the resolved address instead of the configured name, so a
+		// name matches by scheme and port as long as that pair is unique among |uris|.
+		static std::string MatchServer(const std::vector<std::string>& uris, const std::string& url);
+
+		bool IsEnabled();
+		RtcIceServerHealthInfo GetInfo();
+
+	private:
+		struct Server
+		{
+			int64_t smoothedMs = -1;
+			int stalls = 0;
+			int64_t prunedUntilMs = 0;
+		};
+
+		IceServerHealth() = default;
+
+		rtc::CriticalSection crit_;
+		std::map<std::string, Server> servers_;
+		int stallMs_ = 0;
+		int retryMs_ = kDefaultRetryMs;
+		uint64_t skipped_ = 0;
+	};
+
+	// When each server first answered during a gathering round, seen on the sockets of one
+	// peer connection. A port drops the candidate of an answer that maps to the local address
+	// or to another server's, the answer still counts here.
+	class ServerResponseProbe : public sigslot::has_slots<>
+	{
+	public:
+		// Sockets created through the returned factory report to this probe, which outlives them.
+		std::unique_ptr<rtc::PacketSocketFactory> WrapFactory(rtc::PacketSocketFactory* factory);
+		// Called on the network thread as the socket is created. The first socket after a Collect
+		// starts the next gathering round, before any request goes out.
+		void Watch(rtc::AsyncPacketSocket* socket);
+
+		// Milliseconds into the round each of |uris| first answered, -1 if it did not, and ends the
+		// round. Servers configured by name that share scheme and port are left out when some of
+		// them answered, the answers cannot be told apart.
+		std::map<std::string, int64_t> Collect(const std::vector<std::string>& uris);
+
+	private:
+		void OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size, const rtc::SocketAddress& remote, const int64_t& packet_time_us);
+
+		rtc::CriticalSection crit_;
+		int64_t startMs_ = 0;
+		bool collected_ = true;
+		// First response per server kind and address.
+		std::map<std::pair<std::string, rtc::SocketAddress>, int64_t> responses_;
+	};
+}
@@ -0,0 +1,67 @@
+#include "IceTiming.h"
+
+namespace Spitfire
+{
+	RtcIceTiming RtcIceTiming::ForProfile(RtcIceProfile profile)
+	{
+		RtcIceTiming timing;
+		switch (profile)
+		{
+		case RtcIceProfile::DatacenterLowLatency:
+			timing.checkIntervalStrong = 1000;
+			timing.unwritableTimeout = 2000;
+			timing.unwritableMinChecks = 3;
+			timing.inactiveTimeout = 4000;
+			timing.receivingTimeout = 1000;
+			timing.stunKeepaliveInterval = 10000;
+			break;
+		case RtcIceProfile::MobileBattery:
+			timing.checkIntervalStrong = 10000;
+			timing.checkMinInterval = 100;
+			timing.unwritableTimeout = 12000;
+			timing.inactiveTimeout = 25000;
+			timing.receivingTimeout = 12000;
+			timing.stunKeepaliveInterval = 25000;
+			break;
+		case RtcIceProfile::MassiveIdleFanIn:
+			// The minimum interval keeps a burst of new peers from pinging in lockstep.
+			timing.checkIntervalStrong = 15000;
+			timing.checkMinInterval = 500;
+			timing.unwritableTimeout = 20000;
+			timing.inactiveTimeout = 40000;
+			timing.receivingTimeout = 30000;
+			timing.stunKeepaliveInterval = 25000;
+			break;
+		case RtcIceProfile::Default:
+		default:
+			break;
+		}
+		return timing;
+	}
+
+	bool RtcIceTiming::IsDefault() const
+	{
+		return !checkIntervalStrong && !checkIntervalWeak && !checkMinInterval && !unwritableTimeout &&
+			!unwritableMinChecks && !inactiveTimeout && !stunKeepaliveInterval && !receivingTimeout;
+	}
+
+	void RtcIceTiming::Apply(webrtc::PeerConnectionInterface::RTCConfiguration& config) const
+	{
+		if (checkIntervalStrong)
+			config.ice_check_interval_strong_connectivity = checkIntervalStrong;
+		if (checkIntervalWeak)
+			config.ice_check_interval_weak_connectivity = checkIntervalWeak;
+		if (checkMinInterval)
+			config.ice_check_min_interval = checkMinInterval;
+		if (unwritableTimeout)
+			config.ice_unwritable_timeout = unwritableTimeout;
+		if (unwritableMinChecks)
+			config.ice_unwritable_min_checks = unwritableMinChecks;
+		if (inactiveTimeout)
+			config.ice_inactive_timeout = inactiveTimeout;
+		if (stunKeepaliveInterval)
+			config.stun_candidate_keepalive_interval = stunKeepaliveInterval;
+		if (receivingTimeout)
+			config.ice_connection_receiving_timeout = *receivingTimeout;
+	}
+}
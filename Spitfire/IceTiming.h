@@ -0,0 +1,39 @@
+#pragma once
+
+#include "absl/types/optional.h"
+#include "api/peer_connection_interface.h"
+
+namespace Spitfire
+{
+	enum class RtcIceProfile
+	{
+		// libwebrtc defaults.
+		Default,
+		// Low RTT, stable links: frequent checks, a dead peer is noticed within a few seconds.
+		DatacenterLowLatency,
+		// Radio friendly: few keepalives, slower to notice a dead peer.
+		MobileBattery,
+		// Thousands of mostly idle peers per host: sparse checks, spread out, generous timeouts.
+		MassiveIdleFanIn
+	};
+
+	// ICE check and timeout settings applied together. Unset fields keep libwebrtc's default.
+	struct RtcIceTiming
+	{
+		absl::optional<int> checkIntervalStrong;
+		absl::optional<int> checkIntervalWeak;
+		absl::optional<int> checkMinInterval;
+		absl::optional<int> unwritableTimeout;
+		absl::optional<int> unwritableMinChecks;
+		absl::optional<int> inactiveTimeout;
+		absl::optional<int> stunKeepaliveInterval;
+		absl::optional<int> receivingTimeout;
+
+		static RtcIceTiming ForProfile(RtcIceProfile profile);
+
+		// True when nothing is set and libwebrtc's defaults apply.
+		bool IsDefault() const;
+
+		void Apply(webrtc::PeerConnectionInterface::RTCConfiguration& config) const;
+	};
+}
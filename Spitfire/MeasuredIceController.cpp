@@ -0,0 +1,280 @@
+#include "MeasuredIceController.h"
+
+#include <cmath>
+#include <sstream>
+
+#include "p2p/base/connection.h"
+#include "p2p/base/default_ice_transport_factory.h"
+#include "p2p/base/p2p_transport_channel.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	namespace
+	{
+		std::string Describe(const cricket::Candidate& candidate)
+		{
+			return candidate.type() + " " + candidate.address().ToSensitiveString();
+		}
+	}
+
+	void IceSelectionReport::Selected(const cricket::Connection* connection, const std::string& reason)
+	{
+		rtc::CritScope lock(&crit_);
+		info_.local = Describe(connection->local_candidate());
+		info_.remote = Describe(connection->remote_candidate());
+		info_.reason = reason;
+		info_.switches++;
+	}
+
+	void IceSelectionReport::Measured(int rtt_ms, int jitter_ms, double loss)
+	{
+		rtc::CritScope lock(&crit_);
+		info_.rttMs = rtt_ms;
+		info_.jitterMs = jitter_ms;
+		info_.loss = loss;
+	}
+
+	RtcIceSelectionInfo IceSelectionReport::Get()
+	{
+		rtc::CritScope lock(&crit_);
+		return info_;
+	}
+
+	MeasuredIceController::MeasuredIceController(const cricket::IceControllerFactoryArgs& args, std::shared_ptr<IceSelectionReport> report) :
+		basic_(args),
+		iceRole_(args.ice_role_func),
+		report_(report)
+	{
+	}
+
+	void MeasuredIceController::SetIceConfig(const cricket::IceConfig& config)
+	{
+		basic_.SetIceConfig(config);
+	}
+
+	void MeasuredIceController::SetSelectedConnection(const cricket::Connection* selected_connection)
+	{
+		basic_.SetSelectedConnection(selected_connection);
+		if (selected_connection == selected_)
+			return;
+
+		selected_ = selected_connection;
+		challenger_ = nullptr;
+		if (!selected_)
+			return;
+
+		const std::string reason = selected_ == proposed_ ? proposedReason_ : std::string("selected by ICE");
+		RTC_LOG(INFO) << "Selected " << selected_->ToString() << ": " << reason;
+		report_->Selected(selected_, reason);
+		proposed_ = nullptr;
+	}
+
+	void MeasuredIceController::AddConnection(const cricket::Connection* connection)
+	{
+		basic_.AddConnection(connection);
+		measurements_[connection] = Measurement();
+	}
+
+	void MeasuredIceController::OnConnectionDestroyed(const cricket::Connection* connection)
+	{
+		basic_.OnConnectionDestroyed(connection);
+		measurements_.erase(connection);
+		if (challenger_ == connection)
+			challenger_ = nullptr;
+		if (proposed_ == connection)
+			proposed_ = nullptr;
+		if (selected_ == connection)
+			selected_ = nullptr;
+	}
+
+	rtc::ArrayView<const cricket::Connection*> MeasuredIceController::connections() const
+	{
+		return basic_.connections();
+	}
+
+	bool MeasuredIceController::HasPingableConnection() const
+	{
+		return basic_.HasPingableConnection();
+	}
+
+	std::pair<cricket::Connection*, int> MeasuredIceController::SelectConnectionToPing(int64_t last_ping_sent_ms)
+	{
+		return basic_.SelectConnectionToPing(last_ping_sent_ms);
+	}
+
+	bool MeasuredIceController::GetUseCandidateAttr(const cricket::Connection* conn, cricket::NominationMode mode, cricket::IceMode remote_ice_mode) const
+	{
+		return basic_.GetUseCandidateAttr(conn, mode, remote_ice_mode);
+	}
+
+	const cricket::Connection* MeasuredIceController::FindNextPingableConnection()
+	{
+		return basic_.FindNextPingableConnection();
+	}
+
+	void MeasuredIceController::MarkConnectionPinged(const cricket::Connection* con)
+	{
+		basic_.MarkConnectionPinged(con);
+	}
+
+	cricket::IceControllerInterface::SwitchResult MeasuredIceController::ShouldSwitchConnection(cricket::IceControllerEvent reason, const cricket::Connection* connection)
+	{
+		return Decide(basic_.ShouldSwitchConnection(reason, connection));
+	}
+
+	cricket::IceControllerInterface::SwitchResult MeasuredIceController::SortAndSwitchConnection(cricket::IceControllerEvent reason)
+	{
+		// The basic controller's sort still orders pinging and pruning.
+		return Decide(basic_.SortAndSwitchConnection(reason));
+	}
+
+	std::vector<const cricket::Connection*> MeasuredIceController::PruneConnections()
+	{
+		return basic_.PruneConnections();
+	}
+
+	cricket::IceControllerInterface::SwitchResult MeasuredIceController::Decide(SwitchResult proposed)
+	{
+		UpdateLoss();
+		if (selected_)
+			report_->Measured(selected_->rtt(), Jitter(selected_), measurements_[selected_].loss);
+
+		const cricket::Connection* basic = proposed.connection.value_or(nullptr);
+
+		// The controlled side uses what the remote nominated, and a failing selection is left to the basic rules.
+		if (iceRole_() != cricket::ICEROLE_CONTROLLING || !selected_ || selected_->weak())
+		{
+			if (basic)
+				Propose(&proposed, basic, selected_ ? "selected pair failed" : "first usable pair");
+			return proposed;
+		}
+
+		// Switching on priority alone is fine as long as the measurements do not say otherwise.
+		if (basic && basic != selected_)
+		{
+			if (IsMeasured(basic) && IsMeasured(selected_) && Cost(basic) <= Cost(selected_))
+			{
+				Propose(&proposed, basic, "preferred and measured no worse");
+				return proposed;
+			}
+			proposed.connection.reset();
+		}
+
+		if (!IsMeasured(selected_))
+			return proposed;
+
+		const cricket::Connection* best = nullptr;
+		for (const cricket::Connection* connection : basic_.connections())
+		{
+			if (connection == selected_ || connection->weak() || connection->pruned() || !IsMeasured(connection))
+				continue;
+			if (!best || Cost(connection) < Cost(best))
+				best = connection;
+		}
+
+		const double selectedCost = Cost(selected_);
+		const bool better = best && Cost(best) < selectedCost * (1 - kSwitchMargin) && selectedCost - Cost(best) >= kMinSwitchGainMs;
+		const int64_t now = rtc::TimeMillis();
+		if (!better)
+		{
+			challenger_ = nullptr;
+		}
+		else if (best != challenger_)
+		{
+			challenger_ = best;
+			challengerSinceMs_ = now;
+		}
+		else if (now - challengerSinceMs_ >= kSwitchHoldMs)
+		{
+			std::ostringstream reason;
+			reason << "lower cost " << static_cast<int>(Cost(best)) << "ms vs " << static_cast<int>(selectedCost) << "ms"
+				<< " (rtt " << best->rtt() << "/" << selected_->rtt() << "ms, jitter " << Jitter(best) << "/" << Jitter(selected_)
+				<< "ms, loss " << static_cast<int>(measurements_[best].loss * 100) << "/" << static_cast<int>(measurements_[selected_].loss * 100) << "%)";
+			Propose(&proposed, best, reason.str());
+			challenger_ = nullptr;
+		}
+
+		// Measurements move without any event, so come back while there is a pair to compare with.
+		if (best && (!proposed.recheck_event || proposed.recheck_event->recheck_delay_ms > kRecheckMs))
+		{
+			cricket::IceControllerEvent recheck(cricket::IceControllerEvent::ICE_CONTROLLER_RECHECK);
+			recheck.recheck_delay_ms = kRecheckMs;
+			proposed.recheck_event = recheck;
+		}
+		return proposed;
+	}
+
+	void MeasuredIceController::UpdateLoss()
+	{
+		const int64_t now = rtc::TimeMillis();
+		if (now - lossUpdatedMs_ < kLossWindowMs)
+			return;
+		lossUpdatedMs_ = now;
+
+		for (auto& entry : measurements_)
+		{
+			const cricket::Connection* connection = entry.first;
+			Measurement& measurement = entry.second;
+			const int pings = connection->num_pings_sent() - measurement.basePings;
+			const int responses = connection->rtt_samples() - measurement.baseResponses;
+			// A check or two is always in flight, short windows would count them as lost.
+			if (pings < 4)
+				continue;
+
+			const double loss = std::min(1.0, std::max(0.0, 1.0 - static_cast<double>(responses) / pings));
+			measurement.loss = measurement.loss * 0.75 + loss * 0.25;
+			measurement.basePings = connection->num_pings_sent();
+			measurement.baseResponses = connection->rtt_samples();
+		}
+	}
+
+	bool MeasuredIceController::IsMeasured(const cricket::Connection* connection) const
+	{
+		return connection->rtt_samples() >= kMinRttSamples;
+	}
+
+	double MeasuredIceController::Cost(const cricket::Connection* connection) const
+	{
+		auto measurement = measurements_.find(connection);
+		const double loss = measurement != measurements_.end() ? measurement->second.loss : 0;
+		return connection->rtt() + 2.0 * Jitter(connection) + loss * kLossPenaltyMs;
+	}
+
+	int MeasuredIceController::Jitter(const cricket::Connection* connection) const
+	{
+		const double variance = connection->GetRttEstimate().GetVariance();
+		return std::isfinite(variance) && variance > 0 ? static_cast<int>(std::sqrt(variance)) : 0;
+	}
+
+	void MeasuredIceController::Propose(SwitchResult* result, const cricket::Connection* connection, const std::string& reason)
+	{
+		result->connection = connection;
+		proposed_ = connection;
+		proposedReason_ = reason;
+	}
+
+	MeasuredIceControllerFactory::MeasuredIceControllerFactory(std::shared_ptr<IceSelectionReport> report) :
+		report_(report)
+	{
+	}
+
+	std::unique_ptr<cricket::IceControllerInterface> MeasuredIceControllerFactory::Create(const cricket::IceControllerFactoryArgs& args)
+	{
+		return std::unique_ptr<cricket::IceControllerInterface>(new MeasuredIceController(args, report_));
+	}
+
+	MeasuredIceTransportFactory::MeasuredIceTransportFactory(std::shared_ptr<IceSelectionReport> report) :
+		controllers_(report)
+	{
+	}
+
+	rtc::scoped_refptr<webrtc::IceTransportInterface> MeasuredIceTransportFactory::CreateIceTransport(const std::string& transport_name, int component, webrtc::IceTransportInit init)
+	{
+		// The channel only uses the controller factory while it is being constructed.
+		return new rtc::RefCountedObject<webrtc::DefaultIceTransport>(std::make_unique<cricket::P2PTransportChannel>(
+			transport_name, component, init.port_allocator(), init.async_resolver_factory(), init.event_log(), &controllers_));
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "api/ice_transport_interface.h"
+#include "p2p/base/basic_ice_controller.h"
+#include "p2p/base/ice_controller_factory_interface.h"
+#include "rtc_base/critical_section.h"
+
+namespace Spitfire
+{
+	struct RtcIceSelectionInfo
+	{
+		// "type address" of both ends of the selected pair, empty before the first selection.
+		std::string local;
+		std::string remote;
+		int rttMs;
+		int jitterMs;
+		// Share of checks on the selected pair that went unanswered, 0 to 1.
+		double loss;
+		std::string reason;
+		uint32_t switches;
+	};
+
+	// Written on the network thread, read from anywhere.
+	class IceSelectionReport
+	{
+	public:
+		void Selected(const cricket::Connection* connection, const std::string& reason);
+		void Measured(int rtt_ms, int jitter_ms, double loss);
+		RtcIceSelectionInfo Get();
+
+	private:
+		rtc::CriticalSection crit_;
+		RtcIceSelectionInfo info_ = RtcIceSelectionInfo();
+	};
+
+	// Picks the candidate pair by what the STUN checks measure instead of by candidate
+	// priority and network type. Every pair is scored by smoothed RTT, jitter and the
+	// share of unanswered checks. A pair has to beat the selected one by a margin for a
+	// while before the controller switches to it, so two close pairs do not flap.
+	// The pinging, nomination and pruning of BasicIceController are kept as they are,
+	// and a controlled agent follows the remote's nomination.
+	class MeasuredIceController : public cricket::IceControllerInterface
+	{
+	public:
+		// Pairs need this many answered checks before their measurements count.
+		static const int kMinRttSamples = 3;
+		// A challenger must cost this much less than the selected pair, in share and in ms...
+		static constexpr double kSwitchMargin = 0.2;
+		static const int kMinSwitchGainMs = 10;
+		// ...for this long.
+		static const int kSwitchHoldMs = 2000;
+		// Each unanswered check share point weighs like this many ms of RTT.
+		static const int kLossPenaltyMs = 1000;
+		static const int kLossWindowMs = 2000;
+		static const int kRecheckMs = 1000;
+
+		MeasuredIceController(const cricket::IceControllerFactoryArgs& args, std::shared_ptr<IceSelectionReport> report);
+
+		void SetIceConfig(const cricket::IceConfig& config) override;
+		void SetSelectedConnection(const cricket::Connection* selected_connection) override;
+		void AddConnection(const cricket::Connection* connection) override;
+		void OnConnectionDestroyed(const cricket::Connection* connection) override;
+		rtc::ArrayView<const cricket::Connection*> connections() const override;
+
+		bool HasPingableConnection() const override;
+		std::pair<cricket::Connection*, int> SelectConnectionToPing(int64_t last_ping_sent_ms) override;
+		bool GetUseCandidateAttr(const cricket::Connection* conn, cricket::NominationMode mode, cricket::IceMode remote_ice_mode) const override;
+		const cricket::Connection* FindNextPingableConnection() override;
+		void MarkConnectionPinged(const cricket::Connection* con) override;
+
+		SwitchResult ShouldSwitchConnection(cricket::IceControllerEvent reason, const cricket::Connection* connection) override;
+		SwitchResult SortAndSwitchConnection(cricket::IceControllerEvent reason) override;
+		std::vector<const cricket::Connection*> PruneConnections() override;
+
+	private:
+		struct Measurement
+		{
+			int basePings = 0;
+			int baseResponses = 0;
+			double loss = 0;
+		};
+
+		SwitchResult Decide(SwitchResult proposed);
+		void UpdateLoss();
+		bool IsMeasured(const cricket::Connection* connection) const;
+		// Expected cost of sending on |connection| in ms, lower is better.
+		double Cost(const cricket::Connection* connection) const;
+		int Jitter(const cricket::Connection* connection) const;
+		void Propose(SwitchResult* result, const cricket::Connection* connection, const std::string& reason);
+
+		cricket::BasicIceController basic_;
+		std::function<cricket::IceRole()> iceRole_;
+		std::shared_ptr<IceSelectionReport> report_;
+
+		const cricket::Connection* selected_ = nullptr;
+		std::map<const cricket::Connection*, Measurement> measurements_;
+		int64_t lossUpdatedMs_ = 0;
+
+		const cricket::Connection* challenger_ = nullptr;
+		int64_t challengerSinceMs_ = 0;
+		const cricket::Connection* proposed_ = nullptr;
+		std::string proposedReason_;
+	};
+
+	class MeasuredIceControllerFactory : public cricket::IceControllerFactoryInterface
+	{
+	public:
+		explicit MeasuredIceControllerFactory(std::shared_ptr<IceSelectionReport> report);
+
+		std::unique_ptr<cricket::IceControllerInterface> Create(const cricket::IceControllerFactoryArgs& args) override;
+
+	private:
+		std::shared_ptr<IceSelectionReport> report_;
+	};
+
+	// The default ICE transport, with a MeasuredIceController in its channel.
+	class MeasuredIceTransportFactory : public webrtc::IceTransportFactory
+	{
+	public:
+		explicit MeasuredIceTransportFactory(std::shared_ptr<IceSelectionReport> report);
+
+		rtc::scoped_refptr<webrtc::IceTransportInterface> CreateIceTransport(const std::string& transport_name, int component, webrtc::IceTransportInit init) override;
+
+	private:
+		MeasuredIceControllerFactory controllers_;
+	};
+}
@@ -0,0 +1,268 @@
+#include "NetworkEnumerator.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace Spitfire
+{
+	namespace
+	{
+		std::string ToLower(std::string value)
+		{
+			std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c)
+			{
+				return static_cast<char>(std::tolower(c));
+			});
+			return value;
+		}
+
+		bool Matches(const std::vector<std::string>& patterns, const std::string& name, const std::string& description)
+		{
+			for (auto const& pattern : patterns)
+			{
+				if (name.find(pattern) != std::string::npos || description.find(pattern) != std::string::npos)
+					return true;
+			}
+			return false;
+		}
+	}
+
+	NetworkEnumerator& NetworkEnumerator::Instance()
+	{
+		static NetworkEnumerator* const enumerator = new NetworkEnumerator();
+		return *enumerator;
+	}
+
+	void NetworkEnumerator::Start()
+	{
+		rtc::CritScope lock(&crit_);
+		if (thread_)
+			return;
+
+		thread_ = rtc::Thread::CreateWithSocketServer();
+		thread_->SetName("spitfire_networks", nullptr);
+		thread_->Start();
+		thread_->PostTask(RTC_FROM_HERE, [this]()
+		{
+			manager_.reset(new rtc::BasicNetworkManager());
+			manager_->SignalNetworksChanged.connect(this, &NetworkEnumerator::OnNetworksChanged);
+			manager_->StartUpdating();
+		});
+	}
+
+	void NetworkEnumerator::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+		}
+		if (!thread)
+			return;
+
+		thread->Invoke<void>(RTC_FROM_HERE, [this]()
+		{
+			if (manager_)
+			{
+				manager_->StopUpdating();
+				manager_.reset();
+			}
+		});
+		thread->Stop();
+
+		// Peers that already have a list keep it, new ones fall back to their own manager.
+		rtc::CritScope lock(&crit_);
+		snapshot_ = nullptr;
+	}
+
+	bool NetworkEnumerator::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return thread_ != nullptr;
+	}
+
+	void NetworkEnumerator::SetInterfaceFilter(const std::vector<std::string>& allow, const std::vector<std::string>& deny, bool ignore_vpn)
+	{
+		rtc::CritScope lock(&crit_);
+
+		allow_.clear();
+		for (auto const& entry : allow)
+		{
+			allow_.push_back(ToLower(entry));
+		}
+		deny_.clear();
+		for (auto const& entry : deny)
+		{
+			deny_.push_back(ToLower(entry));
+		}
+		ignoreVpn_ = ignore_vpn;
+
+		// Republish the current interfaces through the new filter.
+		if (thread_)
+		{
+			thread_->PostTask(RTC_FROM_HERE, [this]()
+			{
+				if (manager_)
+					OnNetworksChanged();
+			});
+		}
+	}
+
+	bool NetworkEnumerator::IsAllowed(const rtc::Network& network) const
+	{
+		if (ignoreVpn_ && network.type() == rtc::ADAPTER_TYPE_VPN)
+			return false;
+
+		const std::string name = ToLower(network.name());
+		const std::string description = ToLower(network.description());
+		if (!allow_.empty() && !Matches(allow_, name, description))
+			return false;
+		return !Matches(deny_, name, description);
+	}
+
+	void NetworkEnumerator::OnNetworksChanged()
+	{
+		rtc::NetworkManager::NetworkList networks;
+		manager_->GetNetworks(&networks);
+
+		auto snapshot = std::make_shared<Snapshot>();
+		manager_->GetDefaultLocalAddress(AF_INET, &snapshot->ipv4);
+		manager_->GetDefaultLocalAddress(AF_INET6, &snapshot->ipv6);
+
+		rtc::CritScope lock(&crit_);
+		uint32_t ignored = 0;
+		for (auto const* network : networks)
+		{
+			if (IsAllowed(*network))
+				snapshot->networks.push_back(*network);
+			else
+				ignored++;
+		}
+		ignored_ = ignored;
+		enumerations_++;
+
+		snapshot_ = snapshot;
+		for (auto const& subscription : subscriptions_)
+		{
+			Publish(subscription, snapshot_);
+		}
+	}
+
+	void NetworkEnumerator::Publish(const std::shared_ptr<Subscription>& subscription, const std::shared_ptr<const Snapshot>& snapshot)
+	{
+		// Called under |crit_|, a subscription is removed before its thread goes away.
+		std::shared_ptr<Subscription> target = subscription;
+		std::shared_ptr<const Snapshot> networks = snapshot;
+		subscription->thread->PostTask(RTC_FROM_HERE, [target, networks]()
+		{
+			if (target->manager)
+				target->manager->Apply(*networks);
+		});
+	}
+
+	void NetworkEnumerator::Subscribe(const std::shared_ptr<Subscription>& subscription)
+	{
+		rtc::CritScope lock(&crit_);
+		subscriptions_.push_back(subscription);
+		if (snapshot_)
+			Publish(subscription, snapshot_);
+	}
+
+	void NetworkEnumerator::Unsubscribe(const std::shared_ptr<Subscription>& subscription)
+	{
+		rtc::CritScope lock(&crit_);
+		subscriptions_.erase(std::remove(subscriptions_.begin(), subscriptions_.end(), subscription), subscriptions_.end());
+	}
+
+	std::unique_ptr<rtc::NetworkManager> NetworkEnumerator::CreateNetworkManager()
+	{
+		return std::unique_ptr<rtc::NetworkManager>(new SharedNetworkManager(this));
+	}
+
+	RtcNetworkEnumeratorInfo NetworkEnumerator::GetInfo()
+	{
+		auto info = RtcNetworkEnumeratorInfo();
+		rtc::CritScope lock(&crit_);
+
+		info.networks = snapshot_ ? static_cast<uint32_t>(snapshot_->networks.size()) : 0;
+		info.ignored = ignored_;
+		info.subscribers = static_cast<uint32_t>(subscriptions_.size());
+		info.enumerations = enumerations_;
+		return info;
+	}
+
+	SharedNetworkManager::SharedNetworkManager(NetworkEnumerator* enumerator) :
+		enumerator_(enumerator)
+	{
+	}
+
+	SharedNetworkManager::~SharedNetworkManager()
+	{
+		Unsubscribe();
+	}
+
+	void SharedNetworkManager::StartUpdating()
+	{
+		if (startCount_++ > 0)
+		{
+			// Like BasicNetworkManager, a later start is answered with the current list.
+			if (hasNetworks_)
+			{
+				std::shared_ptr<NetworkEnumerator::Subscription> subscription = subscription_;
+				rtc::Thread::Current()->PostTask(RTC_FROM_HERE, [subscription]()
+				{
+					if (subscription->manager)
+						subscription->manager->SignalNetworksChanged();
+				});
+			}
+			return;
+		}
+
+		subscription_ = std::make_shared<NetworkEnumerator::Subscription>();
+		subscription_->thread = rtc::Thread::Current();
+		subscription_->manager = this;
+		enumerator_->Subscribe(subscription_);
+	}
+
+	void SharedNetworkManager::StopUpdating()
+	{
+		if (startCount_ > 0 && --startCount_ == 0)
+			Unsubscribe();
+	}
+
+	void SharedNetworkManager::Unsubscribe()
+	{
+		if (!subscription_)
+			return;
+
+		auto subscription = std::move(subscription_);
+		enumerator_->Unsubscribe(subscription);
+
+		// Tasks already posted check |manager| on the network thread.
+		if (subscription->thread->IsCurrent())
+			subscription->manager = nullptr;
+		else
+			subscription->thread->Invoke<void>(RTC_FROM_HERE, [&subscription]()
+			{
+				subscription->manager = nullptr;
+			});
+	}
+
+	void SharedNetworkManager::Apply(const NetworkEnumerator::Snapshot& snapshot)
+	{
+		NetworkList networks;
+		for (auto const& network : snapshot.networks)
+		{
+			networks.push_back(new rtc::Network(network));
+		}
+
+		bool changed = false;
+		MergeNetworkList(networks, &changed);
+		set_default_local_addresses(snapshot.ipv4, snapshot.ipv6);
+		if (changed || !hasNetworks_)
+		{
+			hasNetworks_ = true;
+			SignalNetworksChanged();
+		}
+	}
+}
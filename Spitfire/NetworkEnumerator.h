@@ -0,0 +1,106 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtc_base/critical_section.h"
+#include "rtc_base/network.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+namespace Spitfire
+{
+	class SharedNetworkManager;
+
+	struct RtcNetworkEnumeratorInfo
+	{
+		uint32_t networks;
+		uint32_t ignored;
+		uint32_t subscribers;
+		uint64_t enumerations;
+	};
+
+	// Enumerates and monitors network interfaces once for the whole process.
+	// Peer connections get a SharedNetworkManager that replays the filtered
+	// result on their own network thread instead of running a BasicNetworkManager each.
+	class NetworkEnumerator : public sigslot::has_slots<>
+	{
+	public:
+		static NetworkEnumerator& Instance();
+
+		void Start();
+		void Stop();
+		bool IsRunning() const;
+
+		// Entries match case-insensitively against an adapter's name or description. An empty
+		// allowlist allows every adapter, the denylist and |ignore_vpn| are applied after it.
+		void SetInterfaceFilter(const std::vector<std::string>& allow, const std::vector<std::string>& deny, bool ignore_vpn);
+
+		std::unique_ptr<rtc::NetworkManager> CreateNetworkManager();
+		RtcNetworkEnumeratorInfo GetInfo();
+
+	private:
+		friend class SharedNetworkManager;
+
+		struct Snapshot
+		{
+			std::vector<rtc::Network> networks;
+			rtc::IPAddress ipv4;
+			rtc::IPAddress ipv6;
+		};
+
+		struct Subscription
+		{
+			rtc::Thread* thread;
+			// Only touched on |thread|.
+			SharedNetworkManager* manager;
+		};
+
+		NetworkEnumerator() = default;
+
+		void Subscribe(const std::shared_ptr<Subscription>& subscription);
+		void Unsubscribe(const std::shared_ptr<Subscription>& subscription);
+		void Publish(const std::shared_ptr<Subscription>& subscription, const std::shared_ptr<const Snapshot>& snapshot);
+
+		void OnNetworksChanged();
+		bool IsAllowed(const rtc::Network& network) const;
+
+		mutable rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		// Only touched on |thread_|.
+		std::unique_ptr<rtc::BasicNetworkManager> manager_;
+
+		std::shared_ptr<const Snapshot> snapshot_;
+		std::vector<std::shared_ptr<Subscription>> subscriptions_;
+
+		std::vector<std::string> allow_;
+		std::vector<std::string> deny_;
+		bool ignoreVpn_ = false;
+
+		uint32_t ignored_ = 0;
+		uint64_t enumerations_ = 0;
+	};
+
+	// Per peer connection view of the process wide interface list.
+	class SharedNetworkManager : public rtc::NetworkManagerBase
+	{
+	public:
+		explicit SharedNetworkManager(NetworkEnumerator* enumerator);
+		~SharedNetworkManager() override;
+
+		void StartUpdating() override;
+		void StopUpdating() override;
+
+	private:
+		friend class NetworkEnumerator;
+
+		void Apply(const NetworkEnumerator::Snapshot& snapshot);
+		void Unsubscribe();
+
+		NetworkEnumerator* enumerator_;
+		std::shared_ptr<NetworkEnumerator::Subscription> subscription_;
+		int startCount_ = 0;
+		bool hasNetworks_ = false;
+	};
+}
@@ -14,6 +14,8 @@ void Spitfire::Observers::PeerConnectionObserver::OnDataChannel(rtc::scoped_refp
 		conductor_->dataObservers[channel->label()] = new DataChannelObserver(conductor_);
 		conductor_->dataObservers[channel->label()]->dataChannel = channel.get();
 		conductor_->dataObservers[channel->label()]->dataChannel->RegisterObserver(conductor_->dataObservers[channel->label()]);
+		DataChannelRelay::Instance().OnDataChannel(conductor_, channel->label(), channel);
+		TopicRegistry::Instance().OnDataChannel(conductor_, channel->label(), channel);
 	}
 }
 
@@ -24,18 +26,38 @@ void Spitfire::Observers::PeerConnectionObserver::OnRenegotiationNeeded()
 
 void Spitfire::Observers::PeerConnectionObserver::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state)
 {
+	// Disconnected means no pair is both receiving and writable, which is the first sign of a
+	// dead peer we get when the receiving change itself is not reported.
+	switch (new_state)
+	{
+	case webrtc::PeerConnectionInterface::kIceConnectionConnected:
+	case webrtc::PeerConnectionInterface::kIceConnectionCompleted:
+		conductor_->OnPeerReceiving(true);
+		break;
+	case webrtc::PeerConnectionInterface::kIceConnectionDisconnected:
+		conductor_->OnPeerReceiving(false);
+		break;
+	case webrtc::PeerConnectionInterface::kIceConnectionFailed:
+		conductor_->OnPeerLost("failed");
+		break;
+	default:
+		break;
+	}
+
 	if (conductor_->onIceStateChange)
 	{
 		conductor_->onIceStateChange(new_state);
 	}
 }
 
+void Spitfire::Observers::PeerConnectionObserver::OnIceConnectionReceivingChange(bool receiving)
+{
+	conductor_->OnPeerReceiving(receiving);
+}
+
 void Spitfire::Observers::PeerConnectionObserver::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state)
 {
-	if (conductor_->onIceGatheringStateChange) 
-	{
-		conductor_->onIceGatheringStateChange(new_state);
-	}
+	conductor_->OnIceGatheringChange(new_state);
 }
 
 void Spitfire::Observers::PeerConnectionObserver::OnIceCandidate(const webrtc::IceCandidateInterface * candidate)
@@ -48,8 +70,13 @@ void Spitfire::Observers::PeerConnectionObserver::OnIceCandidate(const webrtc::I
 		RTC_LOG(LS_ERROR) << "Failed to serialize candidate";
 		return;
 	}
-	if (conductor_->onIceCandidate)
+	if (conductor_->IsBatchingIceCandidates())
+	{
+		conductor_->QueueIceCandidate(candidate->sdp_mid(), candidate->sdp_mline_index(), sdp);
+	}
+	else if (conductor_->onIceCandidate)
 	{
 		conductor_->onIceCandidate(candidate->sdp_mid().c_str(), candidate->sdp_mline_index(), sdp.c_str());
 	}
+	conductor_->OnIceCandidateGathered(candidate);
 }
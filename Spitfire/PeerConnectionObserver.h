@@ -52,7 +52,7 @@ namespace Spitfire
 			virtual void OnIceComplete() { /* Obsolete. Ignore. */ }
 
 			// Called when the ICE connection receiving status changes.
-			void OnIceConnectionReceivingChange(bool receiving) override { /* Not Implemented */ };
+			void OnIceConnectionReceivingChange(bool receiving) override;
 
 			rtc::scoped_refptr<webrtc::PeerConnectionInterface> peerConnection;
 
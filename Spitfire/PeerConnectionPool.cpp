@@ -0,0 +1,178 @@
+#include "PeerConnectionPool.h"
+#include "RtcConductor.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	namespace
+	{
+		const int64_t kMaintenanceIntervalMs = 1000;
+	}
+
+	PeerConnectionPool& PeerConnectionPool::Instance()
+	{
+		static PeerConnectionPool* const pool = new PeerConnectionPool();
+		return *pool;
+	}
+
+	void PeerConnectionPool::Configure(size_t size, int min_port, int max_port, int candidate_pool_size, int64_t idle_expiry_ms)
+	{
+		rtc::CritScope lock(&crit_);
+		size_ = size;
+		minPort_ = min_port;
+		maxPort_ = max_port;
+		candidatePoolSize_ = candidate_pool_size;
+		idleExpiryMs_ = idle_expiry_ms;
+	}
+
+	void PeerConnectionPool::AddServerConfig(const std::string& uri, const std::string& username, const std::string& password)
+	{
+		rtc::CritScope lock(&crit_);
+		servers_.push_back(ServerConfig{ uri, username, password });
+	}
+
+	void PeerConnectionPool::Start()
+	{
+		rtc::CritScope lock(&crit_);
+		if (thread_)
+			return;
+
+		thread_ = rtc::Thread::Create();
+		thread_->SetName("spitfire_pc_pool", nullptr);
+		thread_->Start();
+		thread_->PostTask(RTC_FROM_HERE, [this]()
+		{
+			maintenance_ = webrtc::RepeatingTaskHandle::Start(thread_.get(), [this]()
+			{
+				Maintain();
+				return webrtc::TimeDelta::ms(kMaintenanceIntervalMs);
+			});
+		});
+	}
+
+	void PeerConnectionPool::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+		}
+
+		if (thread)
+		{
+			thread->Invoke<void>(RTC_FROM_HERE, [this]() { maintenance_.Stop(); });
+			thread->Stop();
+		}
+
+		std::deque<IdleConnection> idle;
+		{
+			rtc::CritScope lock(&crit_);
+			idle.swap(idle_);
+		}
+	}
+
+	bool PeerConnectionPool::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return thread_ != nullptr;
+	}
+
+	std::unique_ptr<RtcConductor> PeerConnectionPool::Claim()
+	{
+		std::deque<IdleConnection> expired;
+		rtc::CritScope lock(&crit_);
+		if (!thread_)
+			return nullptr;
+
+		const int64_t now = rtc::TimeMillis();
+		while (!idle_.empty())
+		{
+			IdleConnection connection = std::move(idle_.front());
+			idle_.pop_front();
+			if (idleExpiryMs_ > 0 && now - connection.createdMs > idleExpiryMs_)
+			{
+				expired.push_back(std::move(connection));
+				expired_++;
+				continue;
+			}
+
+			hits_++;
+			return std::move(connection.conductor);
+		}
+
+		misses_++;
+		return nullptr;
+	}
+
+	RtcPeerConnectionPoolInfo PeerConnectionPool::GetInfo() const
+	{
+		auto info = RtcPeerConnectionPoolInfo();
+		rtc::CritScope lock(&crit_);
+		info.idle = static_cast<uint32_t>(idle_.size());
+		info.created = created_;
+		info.expired = expired_;
+		info.hits = hits_;
+		info.misses = misses_;
+		return info;
+	}
+
+	std::unique_ptr<RtcConductor> PeerConnectionPool::CreateConnection()
+	{
+		int min_port, max_port, candidate_pool_size;
+		std::vector<ServerConfig> servers;
+		{
+			rtc::CritScope lock(&crit_);
+			min_port = minPort_;
+			max_port = maxPort_;
+			candidate_pool_size = candidatePoolSize_;
+			servers = servers_;
+		}
+
+		std::unique_ptr<RtcConductor> conductor(new RtcConductor());
+		for (auto const& server : servers)
+		{
+			conductor->AddServerConfig(server.uri, server.username, server.password);
+		}
+		conductor->SetIceCandidatePoolSize(candidate_pool_size);
+		// Never attached to the pool thread, a failed or expired connection would stop it. Whoever
+		// claims the connection becomes the thread driving it.
+		if (!conductor->InitializePeerConnection(min_port, max_port, false))
+		{
+			RTC_LOG(LS_ERROR) << "Failed to create a pooled peer connection";
+			return nullptr;
+		}
+		return conductor;
+	}
+
+	void PeerConnectionPool::Maintain()
+	{
+		std::deque<IdleConnection> expired;
+		size_t missing = 0;
+		{
+			rtc::CritScope lock(&crit_);
+			const int64_t now = rtc::TimeMillis();
+			while (idleExpiryMs_ > 0 && !idle_.empty() && now - idle_.front().createdMs > idleExpiryMs_)
+			{
+				expired.push_back(std::move(idle_.front()));
+				idle_.pop_front();
+				expired_++;
+			}
+			missing = size_ > idle_.size() ? size_ - idle_.size() : 0;
+		}
+
+		// Torn down outside the lock, closing a peer connection blocks on its threads.
+		expired.clear();
+
+		for (size_t i = 0; i < missing; i++)
+		{
+			auto conductor = CreateConnection();
+			if (!conductor)
+				return;
+
+			rtc::CritScope lock(&crit_);
+			idle_.push_back(IdleConnection{ std::move(conductor), rtc::TimeMillis() });
+			created_++;
+		}
+	}
+}
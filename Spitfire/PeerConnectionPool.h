@@ -0,0 +1,85 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtc_base/critical_section.h"
+#include "rtc_base/task_utils/repeating_task.h"
+#include "rtc_base/thread.h"
+
+namespace Spitfire
+{
+	class RtcConductor;
+
+	struct RtcPeerConnectionPoolInfo
+	{
+		uint32_t idle;
+		uint64_t created;
+		uint64_t expired;
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	// Keeps a number of fully initialized, idle peer connections around so a
+	// connecting user can claim one instead of paying for thread start-up,
+	// factory creation, certificate and candidate gathering on the critical path.
+	class PeerConnectionPool
+	{
+	public:
+		static PeerConnectionPool& Instance();
+
+		// |candidate_pool_size| is handed to RTCConfiguration::ice_candidate_pool_size so
+		// idle connections gather ahead of time. Idle connections older than
+		// |idle_expiry_ms| are replaced, zero keeps them indefinitely.
+		void Configure(size_t size, int min_port, int max_port, int candidate_pool_size, int64_t idle_expiry_ms);
+		void AddServerConfig(const std::string& uri, const std::string& username, const std::string& password);
+
+		void Start();
+		void Stop();
+		bool IsRunning() const;
+
+		// Returns an idle conductor, or null when the pool is empty or stopped.
+		std::unique_ptr<RtcConductor> Claim();
+
+		RtcPeerConnectionPoolInfo GetInfo() const;
+
+	private:
+		struct ServerConfig
+		{
+			std::string uri;
+			std::string username;
+			std::string password;
+		};
+
+		struct IdleConnection
+		{
+			std::unique_ptr<RtcConductor> conductor;
+			int64_t createdMs;
+		};
+
+		PeerConnectionPool() = default;
+
+		// Runs on |thread_|, drops expired connections and tops the pool up.
+		void Maintain();
+		std::unique_ptr<RtcConductor> CreateConnection();
+
+		rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		webrtc::RepeatingTaskHandle maintenance_;
+		std::deque<IdleConnection> idle_;
+		std::vector<ServerConfig> servers_;
+
+		size_t size_ = 0;
+		int minPort_ = 1025;
+		int maxPort_ = 65535;
+		int candidatePoolSize_ = 0;
+		int64_t idleExpiryMs_ = 0;
+
+		uint64_t created_ = 0;
+		uint64_t expired_ = 0;
+		uint64_t hits_ = 0;
+		uint64_t misses_ = 0;
+	};
+}
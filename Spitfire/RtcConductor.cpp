@@ -1,5 +1,18 @@
 #include "RtcConductor.h"
+#include "CertificateCache.h"
+#include "CertificatePool.h"
+#include "CompactSdp.h"
+#include "UdpMux.h"
+#include "NetworkEnumerator.h"
+#include "DnsCache.h"
+#include "TurnShare.h"
+#include "IceServerHealth.h"
+#include "pc/session_description.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/time_utils.h"
 #include "p2p/client/basic_port_allocator.h"
+#include "p2p/base/p2p_constants.h"
+#include <algorithm>
 #include <iostream>
 
 using cricket::MediaEngineInterface;
@@ -10,10 +23,19 @@ namespace Spitfire
 	{
 		onError = nullptr;
 		onSuccess = nullptr;
+		onCompactSuccess = nullptr;
 		onFailure = nullptr;
+		onNegotiationComplete = nullptr;
+		onIceStateChange = nullptr;
+		onPeerLost = nullptr;
+		onIceGatheringStateChange = nullptr;
 		onIceCandidate = nullptr;
+		onIceCandidates = nullptr;
 		onDataChannelState = nullptr;
+		onBufferAmountChange = nullptr;
 		onDataMessage = nullptr;
+		onDataBinaryMessage = nullptr;
+		onDataChannelReceiveWindow = nullptr;
 		//dataObserver = new Observers::DataChannelObserver(this);
 		peerObserver = new Observers::PeerConnectionObserver(this);
 		sessionObserver = new Observers::CreateSessionDescriptionObserver(this);
@@ -28,6 +50,10 @@ namespace Spitfire
 
 	void RtcConductor::DeletePeerConnection()
 	{
+		DataChannelRelay::Instance().RemoveConductor(this);
+		TopicRegistry::Instance().RemoveConductor(this);
+		UdpMux::Instance().RemoveConductor(this);
+
 		if (peerObserver)
 		{
 			if (peerObserver->peerConnection)
@@ -40,6 +66,8 @@ namespace Spitfire
 
 		pc_factory_ = nullptr;
 		default_socket_factory_ = nullptr;
+		mux_socket_factory_ = nullptr;
+		probe_socket_factory_ = nullptr;
 		default_network_manager_ = nullptr;
 
 		if (!dataObservers.empty())
@@ -56,18 +84,65 @@ namespace Spitfire
 		}
 		serverConfigs.clear();
 
-		RTC_DCHECK(network_thread_ && worker_thread_ && signaling_thread_);
-		network_thread_->Stop();
-		worker_thread_->Stop();
-		signaling_thread_->Stop();
-		rtc::Thread* current_thread = rtc::ThreadManager::Instance()->CurrentThread();
-		if(current_thread)
-			current_thread->Stop();
+		if (network_thread_)
+			network_thread_->Stop();
+		if (worker_thread_)
+			worker_thread_->Stop();
+		if (signaling_thread_)
+			signaling_thread_->Stop();
+		if (owner_thread_)
+		{
+			owner_thread_->Stop();
+			owner_thread_ = nullptr;
+		}
+		negotiations_ = nullptr;
+	}
+
+	void RtcConductor::AttachOwnerThread()
+	{
+		owner_thread_ = rtc::ThreadManager::Instance()->WrapCurrentThread();
 	}
 
-	bool RtcConductor::InitializePeerConnection(int min_port, int max_port)
+	void RtcConductor::AdoptSettings(const RtcConductor& other)
 	{
-		rtc::ThreadManager::Instance()->WrapCurrentThread();
+		onError = other.onError;
+		onSuccess = other.onSuccess;
+		onCompactSuccess = other.onCompactSuccess;
+		onFailure = other.onFailure;
+		onNegotiationComplete = other.onNegotiationComplete;
+		onIceStateChange = other.onIceStateChange;
+		onPeerLost = other.onPeerLost;
+		onIceGatheringStateChange = other.onIceGatheringStateChange;
+		onIceCandidate = other.onIceCandidate;
+		onIceCandidates = other.onIceCandidates;
+		onDataChannelState = other.onDataChannelState;
+		onBufferAmountChange = other.onBufferAmountChange;
+		onDataMessage = other.onDataMessage;
+		onDataBinaryMessage = other.onDataBinaryMessage;
+		onDataChannelReceiveWindow = other.onDataChannelReceiveWindow;
+
+		compactSignaling_ = other.compactSignaling_;
+		iceLite_ = other.iceLite_;
+		channelTemplates_ = other.channelTemplates_;
+		batchIceCandidates_ = other.batchIceCandidates_;
+		batchWindowMs_ = other.batchWindowMs_;
+		gatheringPolicy_ = other.gatheringPolicy_;
+
+		// Only claimed with default timing and no peer lost bound, which the pooled peer connection
+		// already runs with.
+		iceTiming_ = other.iceTiming_;
+		peerLostTimeoutMs_ = other.peerLostTimeoutMs_;
+	}
+
+	void RtcConductor::SetIceCandidatePoolSize(int size)
+	{
+		ice_candidate_pool_size_ = size;
+	}
+
+	bool RtcConductor::InitializePeerConnection(int min_port, int max_port, bool attach_owner)
+	{
+		if (attach_owner)
+			AttachOwnerThread();
 		RTC_DCHECK(!pc_factory_);
 		RTC_DCHECK(peerObserver && !peerObserver->peerConnection);
 
@@ -88,13 +163,20 @@ namespace Spitfire
 		pc_factory_ = webrtc::CreateModularPeerConnectionFactory(std::move(factory_deps));
 		if(pc_factory_)
 		{
-			default_network_manager_.reset(new rtc::BasicNetworkManager());
+			// The process wide enumerator saves every peer its own interface scan and monitor.
+			if (NetworkEnumerator::Instance().IsRunning())
+				default_network_manager_ = NetworkEnumerator::Instance().CreateNetworkManager();
+			else
+				default_network_manager_.reset(new rtc::BasicNetworkManager());
 			if(default_network_manager_)
 			{
-				default_socket_factory_.reset(new rtc::BasicPacketSocketFactory(network_thread_));
+				default_socket_factory_.reset(new BufferedPacketSocketFactory(network_thread_, socketBuffers_));
 				if(default_socket_factory_)
 				{
-					default_relay_port_factory_.reset(new cricket::TurnPortFactory());
+					// With the share running, UDP TURN servers get one allocation for all peers.
+					default_relay_port_factory_ = TurnShare::Instance().CreateRelayPortFactory();
+					if (!default_relay_port_factory_)
+						default_relay_port_factory_.reset(new cricket::TurnPortFactory());
 					if(default_relay_port_factory_)
 					{
 						webrtc::PeerConnectionFactoryInterface::Options opt;
@@ -124,24 +206,87 @@ namespace Spitfire
 		//no clue why this was set to true
 		config.disable_ipv6 = false;
 		config.disable_ipv6_on_wifi = false;
-		config.network_preference = absl::optional<rtc::AdapterType>(rtc::AdapterType::ADAPTER_TYPE_ETHERNET);
+		// Measured selection goes by what the checks see rather than the adapter type.
+		if (!measuredIceSelection_)
+			config.network_preference = absl::optional<rtc::AdapterType>(rtc::AdapterType::ADAPTER_TYPE_ETHERNET);
 		
 		config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+		config.ice_candidate_pool_size = ice_candidate_pool_size_;
+
+		iceTiming_.Apply(config);
+		if (peerLostTimeoutMs_ > 0)
+			PeerLostTiming(&peerLostGraceMs_).Apply(config);
+
+		// An ICE-lite host is reachable on its own addresses, STUN and TURN servers add nothing.
+		if (!iceLite_)
+		{
+			// Servers that stalled on earlier peer connections are skipped, unless that would leave none.
+			gatheringServers_.clear();
+			for each (auto server in serverConfigs)
+			{
+				if (!IceServerHealth::Instance().IsPruned(server.uri))
+					config.servers.push_back(server);
+			}
+			if (config.servers.empty())
+				config.servers = serverConfigs;
+			for each (auto server in config.servers)
+			{
+				gatheringServers_.push_back(server.uri);
+			}
+		}
+		else
+		{
+			// The remote keeps the pair alive, we only answer its checks and ping rarely.
+			if (!iceTiming_.checkIntervalStrong)
+				config.ice_check_interval_strong_connectivity = kIceLiteCheckIntervalMs;
+		}
 
-		for each (auto server in serverConfigs)
+		rtc::scoped_refptr<rtc::RTCCertificate> certificate;
+		if (CertificateCache::Instance().IsEnabled())
+			certificate = CertificateCache::Instance().GetCertificate();
+		else if (CertificatePool::Instance().IsRunning())
+			certificate = CertificatePool::Instance().Take();
+		if (certificate)
+			config.certificates.push_back(certificate);
+
+		// With the mux running, UDP candidates share its port instead of binding from the range.
+		rtc::PacketSocketFactory* socket_factory = default_socket_factory_.get();
+		mux_socket_factory_ = UdpMux::Instance().CreateSocketFactory(this, network_thread_, socketBuffers_);
+		if (mux_socket_factory_)
+			socket_factory = mux_socket_factory_.get();
+		if (!gatheringServers_.empty() && IceServerHealth::Instance().IsEnabled())
 		{
-			config.servers.push_back(server);
-		}	
+			probe_socket_factory_ = serverProbe_.WrapFactory(socket_factory);
+			socket_factory = probe_socket_factory_.get();
+		}
 
 		std::unique_ptr<cricket::PortAllocator> allocator = std::unique_ptr<cricket::PortAllocator>(new cricket::BasicPortAllocator(
 			default_network_manager_.get(),
-			default_socket_factory_.get(),
+			socket_factory,
 			config.turn_customizer,
 			default_relay_port_factory_.get()));
 		allocator->SetPortRange(minPort, maxPort);
+		if (iceLite_)
+		{
+			allocator->set_flags(allocator->flags() | cricket::PORTALLOCATOR_DISABLE_STUN | cricket::PORTALLOCATOR_DISABLE_RELAY | cricket::PORTALLOCATOR_DISABLE_TCP);
+		}
 
-		peerObserver->peerConnection = pc_factory_->CreatePeerConnection(config, std::move(allocator), nullptr, peerObserver.get());
-		return peerObserver->peerConnection != nullptr;
+		// Server names and remote hostname candidates resolve through the shared cache while it runs.
+		webrtc::PeerConnectionDependencies dependencies(peerObserver.get());
+		dependencies.allocator = std::move(allocator);
+		dependencies.async_resolver_factory = DnsCache::Instance().CreateResolverFactory();
+		if (measuredIceSelection_)
+		{
+			iceSelection_ = std::make_shared<IceSelectionReport>();
+			dependencies.ice_transport_factory.reset(new MeasuredIceTransportFactory(iceSelection_));
+		}
+
+		peerObserver->peerConnection = pc_factory_->CreatePeerConnection(config, std::move(dependencies));
+		if (!peerObserver->peerConnection)
+			return false;
+
+		CreateTemplateChannels();
+		return true;
 	}
 
 	void RtcConductor::AddServerConfig(std::string uri, std::string username, std::string password)
@@ -153,15 +298,98 @@ namespace Spitfire
 		serverConfigs.push_back(server);
 	}
 
+	bool RtcConductor::SetIceTiming(const RtcIceTiming& timing)
+	{
+		if (!HasPeerConnection())
+		{
+			iceTiming_ = timing;
+			return true;
+		}
+
+		auto config = peerObserver->peerConnection->GetConfiguration();
+		timing.Apply(config);
+		webrtc::RTCError error = peerObserver->peerConnection->SetConfiguration(config);
+		if (!error.ok())
+		{
+			RTC_LOG(WARNING) << "Failed to apply ICE timing: " << error.message();
+			return false;
+		}
+		iceTiming_ = timing;
+		return true;
+	}
+
+	bool RtcConductor::SetPeerLostTimeout(int bound_ms)
+	{
+		const int bound = bound_ms > 0 ? std::max(bound_ms, kMinPeerLostTimeoutMs) : 0;
+		// The timing it needs is refused on an existing peer connection.
+		if (bound > 0 && bound != peerLostTimeoutMs_ && HasPeerConnection())
+			return false;
+
+		peerLostTimeoutMs_ = bound;
+		return true;
+	}
+
+	RtcIceTiming RtcConductor::PeerLostTiming(int* grace_ms) const
+	{
+		// Disconnected follows writability: the pair turns unwritable once kPeerLostChecks checks went
+		// unanswered and the unwritable timeout passed since the last response.
+		const int unwritable = std::min(iceTiming_.unwritableTimeout.value_or(cricket::CONNECTION_WRITE_CONNECT_TIMEOUT), peerLostTimeoutMs_ / 2);
+		RtcIceTiming timing = iceTiming_;
+		timing.unwritableTimeout = unwritable;
+		timing.unwritableMinChecks = std::min(iceTiming_.unwritableMinChecks.value_or(static_cast<int>(cricket::CONNECTION_WRITE_CONNECT_FAILURES)), kPeerLostChecks);
+		timing.checkIntervalStrong = std::min(iceTiming_.checkIntervalStrong.value_or(cricket::STRONG_PING_INTERVAL), unwritable / (kPeerLostChecks + 1));
+		timing.receivingTimeout = std::min(iceTiming_.receivingTimeout.value_or(unwritable), unwritable);
+		*grace_ms = peerLostTimeoutMs_ - unwritable;
+		return timing;
+	}
+
+	void RtcConductor::OnPeerReceiving(bool receiving)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+		if (peerLostTimeoutMs_ == 0 || peerLost_ || peerSilent_ == !receiving)
+			return;
+
+		peerSilent_ = !receiving;
+		// Hearing from the peer again bumps the check, which turns a pending one into a no-op.
+		const uint32_t check = ++peerLostCheck_;
+		if (receiving)
+			return;
+
+		signaling_thread_->PostDelayedTask(webrtc::ToQueuedTask([this, check]()
+		{
+			if (check == peerLostCheck_)
+				OnPeerLost("timeout");
+		}), peerLostGraceMs_);
+	}
+
+	void RtcConductor::OnPeerLost(const char * reason)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+		if (peerLostTimeoutMs_ == 0 || peerLost_)
+			return;
+
+		peerLost_ = true;
+		peerLostCheck_++;
+		RTC_LOG(WARNING) << "Peer lost: " << reason;
+		if (onPeerLost)
+		{
+			onPeerLost(reason);
+		}
+	}
+
 	void RtcConductor::CreateOffer()
 	{
 		if (!peerObserver->peerConnection)
 			return;
 
-		webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
-		options.offer_to_receive_audio = false;
-		options.offer_to_receive_video = false;
-		peerObserver->peerConnection->CreateOffer(sessionObserver, options);
+		if (iceLite_)
+		{
+			if (onFailure)
+				onFailure(kIceLiteOfferError);
+			return;
+		}
+
+		peerObserver->peerConnection->CreateOffer(sessionObserver, OfferOptions());
 	}
 
 	void RtcConductor::OnOfferReply(std::string type, std::string sdp)
@@ -192,14 +420,214 @@ namespace Spitfire
 			return;
 		}
 		peerObserver->peerConnection->SetRemoteDescription(setSessionObserver, session_description);
+		peerObserver->peerConnection->CreateAnswer(sessionObserver, AnswerOptions());
+	}
 
+	bool RtcConductor::OnOfferReplyCompact(const char* data, size_t size)
+	{
+		RtcCompactDescription compact;
+		if (!CompactSdp::Deserialize(data, size, &compact))
+		{
+			RTC_LOG(WARNING) << "Can't parse received compact session description.";
+			return false;
+		}
+		OnOfferReply(compact.type, CompactSdp::ToSdp(compact));
+		return true;
+	}
+
+	bool RtcConductor::OnOfferRequestCompact(const char* data, size_t size)
+	{
+		RtcCompactDescription compact;
+		if (!CompactSdp::Deserialize(data, size, &compact) || compact.type != "offer")
+		{
+			RTC_LOG(WARNING) << "Can't parse received compact session description.";
+			return false;
+		}
+		OnOfferRequest(CompactSdp::ToSdp(compact));
+		return true;
+	}
+
+	bool RtcConductor::GetLocalCompactDescription(std::string* out)
+	{
+		if (!HasPeerConnection())
+			return false;
+
+		// The description is owned by the signaling thread, read it there.
+		return signaling_thread_->Invoke<bool>(RTC_FROM_HERE, [this, out]()
+		{
+			RtcCompactDescription compact;
+			return CompactSdp::FromDescription(peerObserver->peerConnection->local_description(), &compact) &&
+				CompactSdp::Serialize(compact, out);
+		});
+	}
+
+	void RtcConductor::OnLocalDescriptionCreated(const webrtc::SessionDescriptionInterface* desc)
+	{
+		if (!UdpMux::Instance().IsRunning() || !desc->description())
+			return;
+
+		// Checks arriving on the shared port find us by our ufrag.
+		for (auto const& transport : desc->description()->transport_infos())
+		{
+			UdpMux::Instance().RegisterUfrag(this, transport.description.ice_ufrag);
+		}
+	}
+
+	webrtc::PeerConnectionInterface::RTCOfferAnswerOptions RtcConductor::OfferOptions()
+	{
+		webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
+		options.offer_to_receive_audio = false;
+		options.offer_to_receive_video = false;
+		return options;
+	}
+
+	webrtc::PeerConnectionInterface::RTCOfferAnswerOptions RtcConductor::AnswerOptions()
+	{
 		webrtc::PeerConnectionInterface::RTCOfferAnswerOptions o;
 		{
 			o.voice_activity_detection = false;
 			o.offer_to_receive_audio = false;
 			o.offer_to_receive_video = webrtc::PeerConnectionInterface::RTCOfferAnswerOptions::kOfferToReceiveMediaTrue;
 		}
-		peerObserver->peerConnection->CreateAnswer(sessionObserver, o);
+		return o;
+	}
+
+	void RtcConductor::ChainNegotiation(uint64_t id, std::function<void(std::function<void()>)> operation)
+	{
+		if (!signaling_thread_ || !HasPeerConnection())
+		{
+			CompleteNegotiation(id, false, "", "", "The peer connection is not initialized");
+			return;
+		}
+
+		// OperationsChain is bound to the thread that uses it, which is the signaling thread.
+		signaling_thread_->PostTask(RTC_FROM_HERE, [this, operation]() mutable
+		{
+			if (!negotiations_)
+				negotiations_ = rtc::OperationsChain::Create();
+			negotiations_->ChainOperation(std::move(operation));
+		});
+	}
+
+	void RtcConductor::SetLocalDescriptionAsync(uint64_t id, webrtc::SessionDescriptionInterface* desc, std::function<void()> done)
+	{
+		std::string type = desc->type();
+		std::string sdp;
+		desc->ToString(&sdp);
+
+		rtc::scoped_refptr<Observers::SetSessionDescriptionObserver> observer(new Observers::SetSessionDescriptionObserver(this,
+			[this, id, type, sdp, done](bool success, const std::string& error)
+		{
+			CompleteNegotiation(id, success, type, sdp, error);
+			done();
+		}));
+		OnLocalDescriptionCreated(desc);
+		peerObserver->peerConnection->SetLocalDescription(observer, desc);
+	}
+
+	void RtcConductor::CompleteNegotiation(uint64_t id, bool success, const std::string& type, const std::string& sdp, const std::string& error)
+	{
+		if (onNegotiationComplete)
+		{
+			onNegotiationComplete(id, success, type.c_str(), sdp.c_str(), error.c_str());
+		}
+	}
+
+	void RtcConductor::CreateOfferAsync(uint64_t id)
+	{
+		ChainNegotiation(id, [this, id](std::function<void()> done)
+		{
+			if (!HasPeerConnection())
+			{
+				CompleteNegotiation(id, false, "", "", "The peer connection was closed");
+				done();
+				return;
+			}
+			if (iceLite_)
+			{
+				CompleteNegotiation(id, false, "", "", kIceLiteOfferError);
+				done();
+				return;
+			}
+
+			rtc::scoped_refptr<Observers::CreateSessionDescriptionObserver> observer(new Observers::CreateSessionDescriptionObserver(this,
+				[this, id, done](webrtc::SessionDescriptionInterface* desc, const std::string& error)
+			{
+				if (!desc)
+				{
+					CompleteNegotiation(id, false, "", "", error);
+					done();
+					return;
+				}
+				SetLocalDescriptionAsync(id, desc, done);
+			}));
+			peerObserver->peerConnection->CreateOffer(observer, OfferOptions());
+		});
+	}
+
+	void RtcConductor::OnOfferReplyAsync(uint64_t id, std::string type, std::string sdp)
+	{
+		ChainNegotiation(id, [this, id, type, sdp](std::function<void()> done)
+		{
+			webrtc::SdpParseError error;
+			webrtc::SessionDescriptionInterface* session_description(webrtc::CreateSessionDescription(type, sdp, &error));
+			if (!session_description || !HasPeerConnection())
+			{
+				CompleteNegotiation(id, false, type, "", session_description ? "The peer connection was closed" : error.description);
+				delete session_description;
+				done();
+				return;
+			}
+
+			rtc::scoped_refptr<Observers::SetSessionDescriptionObserver> observer(new Observers::SetSessionDescriptionObserver(this,
+				[this, id, type, done](bool success, const std::string& error)
+			{
+				CompleteNegotiation(id, success, type, "", error);
+				done();
+			}));
+			peerObserver->peerConnection->SetRemoteDescription(observer, session_description);
+		});
+	}
+
+	void RtcConductor::OnOfferRequestAsync(uint64_t id, std::string sdp)
+	{
+		ChainNegotiation(id, [this, id, sdp](std::function<void()> done)
+		{
+			webrtc::SdpParseError error;
+			webrtc::SessionDescriptionInterface* session_description(webrtc::CreateSessionDescription("offer", sdp, &error));
+			if (!session_description || !HasPeerConnection())
+			{
+				CompleteNegotiation(id, false, "answer", "", session_description ? "The peer connection was closed" : error.description);
+				delete session_description;
+				done();
+				return;
+			}
+
+			rtc::scoped_refptr<Observers::SetSessionDescriptionObserver> observer(new Observers::SetSessionDescriptionObserver(this,
+				[this, id, done](bool success, const std::string& error)
+			{
+				if (!success || !HasPeerConnection())
+				{
+					CompleteNegotiation(id, false, "answer", "", success ? "The peer connection was closed" : error);
+					done();
+					return;
+				}
+
+				rtc::scoped_refptr<Observers::CreateSessionDescriptionObserver> answerObserver(new Observers::CreateSessionDescriptionObserver(this,
+					[this, id, done](webrtc::SessionDescriptionInterface* desc, const std::string& error)
+				{
+					if (!desc)
+					{
+						CompleteNegotiation(id, false, "answer", "", error);
+						done();
+						return;
+					}
+					SetLocalDescriptionAsync(id, desc, done);
+				}));
+				peerObserver->peerConnection->CreateAnswer(answerObserver, AnswerOptions());
+			}));
+			peerObserver->peerConnection->SetRemoteDescription(observer, session_description);
+		});
 	}
 
 	bool RtcConductor::AddIceCandidate(std::string sdp_mid, int sdp_mlineindex, std::string sdp)
@@ -224,15 +652,226 @@ namespace Spitfire
 		return true;
 	}
 
+	int RtcConductor::AddIceCandidates(const std::vector<RtcIceCandidate>& candidates)
+	{
+		if (!HasPeerConnection())
+			return 0;
+
+		return signaling_thread_->Invoke<int>(RTC_FROM_HERE, [this, &candidates]()
+		{
+			int applied = 0;
+			for (auto const& entry : candidates)
+			{
+				webrtc::SdpParseError error;
+				std::unique_ptr<webrtc::IceCandidateInterface> candidate(webrtc::CreateIceCandidate(entry.sdpMid, entry.sdpMlineIndex, entry.sdp, &error));
+				if (!candidate)
+				{
+					RTC_LOG(WARNING) << "Can't parse received candidate message. "
+						<< "SdpParseError was: " << error.description;
+					continue;
+				}
+
+				if (peerObserver->peerConnection->AddIceCandidate(candidate.get()))
+					applied++;
+				else
+					RTC_LOG(WARNING) << "Failed to apply the received candidate";
+			}
+			return applied;
+		});
+	}
+
+	void RtcConductor::SetIceCandidateBatching(bool enabled, int window_ms)
+	{
+		batchIceCandidates_ = enabled;
+		batchWindowMs_ = std::max(0, window_ms);
+	}
+
+	void RtcConductor::QueueIceCandidate(const std::string& sdp_mid, int sdp_mlineindex, const std::string& sdp)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+
+		pendingCandidates_.push_back(RtcIceCandidate{ sdp_mid, sdp_mlineindex, sdp });
+		if (pendingCandidates_.size() == 1 && batchWindowMs_ > 0)
+		{
+			// A flush caused by gathering completing bumps the batch, which turns this into a no-op.
+			const uint32_t batch = candidateBatch_;
+			signaling_thread_->PostDelayedTask(webrtc::ToQueuedTask([this, batch]()
+			{
+				if (batch == candidateBatch_)
+					FlushIceCandidates();
+			}), batchWindowMs_);
+		}
+	}
+
+	void RtcConductor::FlushIceCandidates()
+	{
+		candidateBatch_++;
+		if (pendingCandidates_.empty())
+			return;
+
+		std::vector<RtcIceCandidate> batch;
+		batch.swap(pendingCandidates_);
+		if (onIceCandidates)
+		{
+			onIceCandidates(batch.data(), static_cast<uint32_t>(batch.size()));
+		}
+		else if (onIceCandidate)
+		{
+			for (auto const& candidate : batch)
+			{
+				onIceCandidate(candidate.sdpMid.c_str(), candidate.sdpMlineIndex, candidate.sdp.c_str());
+			}
+		}
+	}
+
+	void RtcConductor::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState state)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+		if (state == webrtc::PeerConnectionInterface::kIceGatheringGathering)
+		{
+			gatheringReported_ = false;
+			gatheringStartMs_ = rtc::TimeMillis();
+			serverResponses_.clear();
+
+			// A later round bumps the counter, which turns this into a no-op.
+			const uint32_t round = ++gatheringRound_;
+			if (gatheringPolicy_.deadlineMs > 0)
+			{
+				signaling_thread_->PostDelayedTask(webrtc::ToQueuedTask([this, round]()
+				{
+					if (round == gatheringRound_)
+						CompleteGathering("deadline");
+				}), gatheringPolicy_.deadlineMs);
+			}
+		}
+		else if (state == webrtc::PeerConnectionInterface::kIceGatheringComplete)
+		{
+			// Relays shared across peer connections answer on sockets the probe never sees, their
+			// candidates still count. Servers the probe could not tell apart are not recorded.
+			if (probe_socket_factory_)
+			{
+				std::map<std::string, int64_t> responses = serverProbe_.Collect(gatheringServers_);
+				for (auto const& response : serverResponses_)
+				{
+					auto probed = responses.find(response.first);
+					if (probed == responses.end() || probed->second < 0)
+						responses[response.first] = response.second;
+				}
+				for (auto const& response : responses)
+					IceServerHealth::Instance().Record(response.first, response.second);
+			}
+
+			// Candidates held back since an early completion still go out.
+			if (gatheringReported_)
+			{
+				FlushIceCandidates();
+				return;
+			}
+			CompleteGathering("all servers done");
+			return;
+		}
+
+		if (onIceGatheringStateChange)
+		{
+			onIceGatheringStateChange(state);
+		}
+	}
+
+	void RtcConductor::OnIceCandidateGathered(const webrtc::IceCandidateInterface* candidate)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+		const cricket::Candidate& gathered = candidate->candidate();
+
+		const std::string server = IceServerHealth::MatchServer(gatheringServers_, gathered.url());
+		if (!server.empty() && serverResponses_.find(server) == serverResponses_.end())
+			serverResponses_[server] = rtc::TimeMillis() - gatheringStartMs_;
+
+		const bool reflexive = gathered.type() == cricket::STUN_PORT_TYPE;
+		if (gatheringPolicy_.firstServerReflexive && reflexive)
+		{
+			CompleteGathering("first server reflexive candidate");
+			return;
+		}
+
+		// A public host address, or a mapped address equal to the local one, means no NAT in the way.
+		const rtc::IPAddress& ip = gathered.address().ipaddr();
+		const bool direct = gathered.type() == cricket::LOCAL_PORT_TYPE ? !ip.IsNil() && !rtc::IPIsPrivate(ip) :
+			reflexive && ip == gathered.related_address().ipaddr();
+		if (gatheringPolicy_.relayNotNeeded && direct)
+			CompleteGathering("relay not needed");
+	}
+
+	void RtcConductor::CompleteGathering(const char* reason)
+	{
+		if (gatheringReported_)
+			return;
+
+		gatheringReported_ = true;
+		RTC_LOG(INFO) << "ICE gathering complete: " << reason;
+
+		// Held back candidates go out before the application hears gathering is done.
+		FlushIceCandidates();
+		if (onIceGatheringStateChange)
+		{
+			onIceGatheringStateChange(webrtc::PeerConnectionInterface::kIceGatheringComplete);
+		}
+	}
+
 	void RtcConductor::CreateDataChannel(const std::string & label, const webrtc::DataChannelInit dc_options)
 	{
 		if (!peerObserver->peerConnection)
 			return;
 
 		if (dataObservers.find(label) == dataObservers.end()) {
+			// Fails on an invalid or already used negotiated id, e.g. a template clashing with another channel.
+			auto channel = peerObserver->peerConnection->CreateDataChannel(label, &dc_options);
+			if (!channel)
+			{
+				RTC_LOG(LERROR) << "Failed to create data channel " << label;
+				if (onFailure)
+				{
+					const std::string error = "Failed to create data channel " + label;
+					onFailure(error.c_str());
+				}
+				return;
+			}
+
 			dataObservers[label] = new Observers::DataChannelObserver(this);
-			dataObservers[label]->dataChannel = peerObserver->peerConnection->CreateDataChannel(label, &dc_options);
+			dataObservers[label]->dataChannel = channel;
 			dataObservers[label]->dataChannel->RegisterObserver(dataObservers[label]);
+			DataChannelRelay::Instance().OnDataChannel(this, label, dataObservers[label]->dataChannel);
+			TopicRegistry::Instance().OnDataChannel(this, label, dataObservers[label]->dataChannel);
+		}
+	}
+
+	void RtcConductor::AddChannelTemplate(const std::string& label, webrtc::DataChannelInit options)
+	{
+		options.negotiated = true;
+		if (options.id < 0)
+		{
+			int id = 0;
+			for (auto const& entry : channelTemplates_)
+			{
+				id = std::max(id, entry.second.id + 1);
+			}
+			options.id = id;
+		}
+		channelTemplates_.emplace_back(label, options);
+
+		if (HasPeerConnection())
+			CreateDataChannel(label, options);
+	}
+
+	void RtcConductor::ClearChannelTemplates()
+	{
+		channelTemplates_.clear();
+	}
+
+	void RtcConductor::CreateTemplateChannels()
+	{
+		for (auto const& entry : channelTemplates_)
+		{
+			CreateDataChannel(entry.first, entry.second);
 		}
 	}
 
@@ -293,4 +932,77 @@ namespace Spitfire
 		}
 	}
 
-}
\ No newline at end of file
+	rtc::scoped_refptr<webrtc::DataChannelInterface> RtcConductor::GetDataChannel(const std::string& label)
+	{
+		const auto observer = dataObservers.find(label);
+		if (observer != dataObservers.end()) {
+			return observer->second->dataChannel;
+		}
+		return nullptr;
+	}
+
+	void RtcConductor::SetDataChannelReceiveWindow(const std::string& label, RtcReceiveMode mode, uint64_t window)
+	{
+		auto observer = dataObservers.find(label);
+		if (observer != dataObservers.end()) {
+			observer->second->SetReceiveWindow(mode, window);
+		}
+	}
+
+	void RtcConductor::AcknowledgeDataMessages(const std::string& label, uint64_t bytes)
+	{
+		auto observer = dataObservers.find(label);
+		if (observer != dataObservers.end()) {
+			observer->second->Acknowledge(bytes);
+		}
+	}
+
+	size_t RtcConductor::DrainDataMessages(const std::string& label, std::vector<webrtc::DataBuffer>& messages, size_t max_messages)
+	{
+		auto observer = dataObservers.find(label);
+		if (observer != dataObservers.end()) {
+			return observer->second->Drain(messages, max_messages);
+		}
+		return 0;
+	}
+
+	void RtcConductor::AddDataChannelRoute(const std::string& label, RtcConductor* destination, const std::string& destination_label)
+	{
+		DataChannelRelay::Instance().AddRoute(this, label, destination, destination_label);
+	}
+
+	void RtcConductor::RemoveDataChannelRoute(const std::string& label, RtcConductor* destination, const std::string& destination_label)
+	{
+		DataChannelRelay::Instance().RemoveRoute(this, label, destination, destination_label);
+	}
+
+	void RtcConductor::SetDataChannelForwardOnly(const std::string& label, bool forward_only)
+	{
+		DataChannelRelay::Instance().SetForwardOnly(this, label, forward_only);
+	}
+
+	RtcDataChannelRouteInfo RtcConductor::GetDataChannelRouteInfo(const std::string& label, RtcConductor* destination, const std::string& destination_label)
+	{
+		return DataChannelRelay::Instance().GetRouteInfo(this, label, destination, destination_label);
+	}
+
+	void RtcConductor::SubscribeTopic(const std::string& label, const std::string& topic, RtcTopicBackpressure policy, uint64_t max_queued_bytes)
+	{
+		TopicRegistry::Instance().Subscribe(this, label, topic, policy, max_queued_bytes);
+	}
+
+	void RtcConductor::UnsubscribeTopic(const std::string& label, const std::string& topic)
+	{
+		TopicRegistry::Instance().Unsubscribe(this, label, topic);
+	}
+
+	void RtcConductor::PublishDataChannel(const std::string& label, const std::string& topic, bool forward_only)
+	{
+		TopicRegistry::Instance().BindPublisher(this, label, topic, forward_only);
+	}
+
+	void RtcConductor::UnpublishDataChannel(const std::string& label)
+	{
+		TopicRegistry::Instance().UnbindPublisher(this, label);
+	}
+}
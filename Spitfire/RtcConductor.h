@@ -7,7 +7,14 @@
 #include "PeerConnectionObserver.h"
 #include "CreateSessionDescriptionObserver.h"
 #include "SetSessionDescriptionObserver.h"
+#include "DataChannelRelay.h"
+#include "TopicRegistry.h"
+#include "IceTiming.h"
+#include "SocketBuffers.h"
+#include "MeasuredIceController.h"
+#include "IceServerHealth.h"
 #include "api/peer_connection_interface.h"
+#include "rtc_base/operations_chain.h"
 #include "p2p/client/relay_port_factory_interface.h"
 #include "p2p/base/basic_packet_socket_factory.h"
 
@@ -40,29 +47,182 @@ namespace Spitfire
 		webrtc::DataChannelInterface::DataState state;
 	};
 
+	struct RtcIceCandidate
+	{
+		std::string sdpMid;
+		int sdpMlineIndex;
+		std::string sdp;
+	};
+
+	// Ways to report ICE gathering complete before the slowest server answered. Candidates
+	// found later still trickle out, and the real completion is not reported again.
+	struct RtcGatheringPolicy
+	{
+		// Once the first server reflexive candidate is in.
+		bool firstServerReflexive = false;
+		// This long after gathering started, zero waits for every server.
+		int deadlineMs = 0;
+		// Once a candidate shows this host is reachable without NAT, a relay adds nothing then.
+		bool relayNotNeeded = false;
+	};
+
 	typedef void(__stdcall *OnErrorCallbackNative)();
 	typedef void(__stdcall *OnSuccessCallbackNative)(const char * type, const char * sdp);
+	typedef void(__stdcall *OnCompactSuccessCallbackNative)(const char * type, const uint8_t * data, uint32_t size);
 	typedef void(__stdcall *OnFailureCallbackNative)(const char * error);
+	typedef void(__stdcall *OnNegotiationCompleteCallbackNative)(uint64_t id, bool success, const char * type, const char * sdp, const char * error);
 	typedef void(__stdcall *OnIceCandidateCallbackNative)(const char * sdpMid, int sdpIndex, const char * sdp);
+	typedef void(__stdcall *OnIceCandidatesCallbackNative)(const RtcIceCandidate * candidates, uint32_t count);
 	typedef void(__stdcall *OnRenderCallbackNative)(uint8_t * frameBuffer, uint32_t w, uint32_t h);
 	typedef void(__stdcall *OnDataMessageCallbackNative)(const char * label, const char * msg);
 	typedef void(__stdcall *OnDataBinaryMessageCallbackNative)(const char * label, const uint8_t * msg, uint32_t size);
 	typedef void(__stdcall *OnIceStateChangeCallbackNative)(webrtc::PeerConnectionInterface::IceConnectionState state);
+	typedef void(__stdcall *OnPeerLostCallbackNative)(const char * reason);
 	typedef void(__stdcall* OnIceGatheringStateCallbackNative)(webrtc::PeerConnectionInterface::IceGatheringState state);
 	typedef void(__stdcall *OnDataChannelStateCallbackNative)(const char * label, webrtc::DataChannelInterface::DataState state);
+	typedef void(__stdcall *OnDataChannelReceiveWindowCallbackNative)(const char * label, bool paused, uint64_t pendingBytes);
 	typedef void(__stdcall *OnBufferAmountCallbackNative)(const char * label, uint64_t previousAmount, uint64_t currentAmount, uint64_t bytesSent, uint64_t bytesReceived);
 
 	class RtcConductor
 	{
 	public:
+		// Check interval on strong connections in ICE-lite mode, the remote's checks keep the pair alive.
+		static const int kIceLiteCheckIntervalMs = 25000;
+		static constexpr const char* kIceLiteOfferError = "ICE-lite peers answer, the offerer would take the controlling role";
+		// Shortest peer lost bound, below this a few late check responses would already trip it.
+		static const int kMinPeerLostTimeoutMs = 1000;
+		// Unanswered checks that turn a silent peer's pair unwritable under a peer lost bound.
+		static const int kPeerLostChecks = 3;
+
 		RtcConductor();
 		~RtcConductor();
 
-		bool InitializePeerConnection(int min_port, int max_port);
+		// Without |attach_owner| no thread is stopped on DeletePeerConnection, for callers that run
+		// on a thread of their own such as the pool.
+		bool InitializePeerConnection(int min_port, int max_port, bool attach_owner = true);
+		bool HasPeerConnection() const
+		{
+			return peerObserver && peerObserver->peerConnection;
+		}
+
+		// Makes the calling thread the one whose message loop is stopped on DeletePeerConnection.
+		void AttachOwnerThread();
+		// Everything a pooled conductor takes over from the one it replaces: callbacks, signaling
+		// and channel settings, and the transport settings applied to its peer connection.
+		void AdoptSettings(const RtcConductor& other);
+		void SetIceCandidatePoolSize(int size);
+
+		// Sizes the buffers of this peer's own UDP sockets, call before InitializePeerConnection.
+		void SetSocketBufferSizes(const RtcSocketBufferSizes& buffers)
+		{
+			socketBuffers_ = buffers;
+		}
+
+		// Applied at creation. libwebrtc refuses most of these fields on an existing peer connection,
+		// the call then fails and the timing in effect stays as it was.
+		bool SetIceTiming(const RtcIceTiming& timing);
+		const RtcIceTiming& GetIceTiming() const
+		{
+			return iceTiming_;
+		}
+
+		// Raises onPeerLost once, at most |bound_ms| after the last packet from the remote. ICE reports
+		// disconnected once the pair turns unwritable, so half of the bound goes to the unwritable
+		// timeout with checks sped up to fill it, the rest is a grace period for the peer to recover.
+		// The tightened timing applies to the peer connection only, GetIceTiming still returns the
+		// user's. ICE failing reports the loss right away. Zero turns detection off, which works any
+		// time, a bound has to be set before the peer connection is created or false is returned.
+		bool SetPeerLostTimeout(int bound_ms);
+		int GetPeerLostTimeout() const
+		{
+			return peerLostTimeoutMs_;
+		}
+		// Called on the signaling thread whenever the remote starts or stops being heard from.
+		void OnPeerReceiving(bool receiving);
+		void OnPeerLost(const char * reason);
+
+		// Server mode for publicly addressable hosts: only host candidates are gathered and our own
+		// checks on a strong pair are cut down to a sparse keepalive. libwebrtc has no local lite agent,
+		// so nothing advertises a=ice-lite. The answerer is controlled and the remote drives nomination,
+		// creating an offer in this mode fails.
+		void SetIceLite(bool enabled)
+		{
+			iceLite_ = enabled;
+		}
+		bool IsIceLite() const
+		{
+			return iceLite_;
+		}
+		// Selects the candidate pair by measured RTT, jitter and loss instead of priority and
+		// network type, see MeasuredIceController. Call before InitializePeerConnection.
+		void SetMeasuredIceSelection(bool enabled)
+		{
+			measuredIceSelection_ = enabled;
+		}
+		bool IsMeasuredIceSelection() const
+		{
+			return measuredIceSelection_;
+		}
+		// The selected pair and why it was chosen, empty without measured selection.
+		RtcIceSelectionInfo GetIceSelectionInfo() const
+		{
+			return iceSelection_ ? iceSelection_->Get() : RtcIceSelectionInfo();
+		}
+
+		// Called with every description we are about to apply locally.
+		void OnLocalDescriptionCreated(const webrtc::SessionDescriptionInterface* desc);
+
 		void CreateOffer();
 		void OnOfferReply(std::string type, std::string sdp);
 		void OnOfferRequest(std::string sdp);
 		bool AddIceCandidate(std::string sdp_mid, int sdp_mlineindex, std::string sdp);
+		// Parses and applies every candidate in one signaling thread task, returns how many were applied.
+		int AddIceCandidates(const std::vector<RtcIceCandidate>& candidates);
+
+		// Holds local candidates back and reports them together through onIceCandidates, once
+		// |window_ms| has passed since the first one or gathering completes, whichever is first.
+		// A zero window waits for gathering to complete.
+		void SetIceCandidateBatching(bool enabled, int window_ms);
+		bool IsBatchingIceCandidates() const
+		{
+			return batchIceCandidates_;
+		}
+		void QueueIceCandidate(const std::string& sdp_mid, int sdp_mlineindex, const std::string& sdp);
+		void FlushIceCandidates();
+
+		void SetGatheringPolicy(const RtcGatheringPolicy& policy)
+		{
+			gatheringPolicy_ = policy;
+		}
+		const RtcGatheringPolicy& GetGatheringPolicy() const
+		{
+			return gatheringPolicy_;
+		}
+		// Gathering progress from the observer on the signaling thread, candidates come in
+		// after they went to the application.
+		void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState state);
+		void OnIceCandidateGathered(const webrtc::IceCandidateInterface* candidate);
+
+		// Data channel only descriptions are reported through onCompactSuccess in the
+		// CompactSdp wire form instead of SDP text. Anything else still uses onSuccess.
+		void SetCompactSignaling(bool enabled)
+		{
+			compactSignaling_ = enabled;
+		}
+		bool IsCompactSignaling() const
+		{
+			return compactSignaling_;
+		}
+		bool OnOfferReplyCompact(const char* data, size_t size);
+		bool OnOfferRequestCompact(const char* data, size_t size);
+		// The current local description in compact form, including gathered candidates.
+		bool GetLocalCompactDescription(std::string* out);
+
+		// Negotiation steps that report back through onNegotiationComplete with the caller's |id|.
+		// Steps are chained per peer connection on the signaling thread, so they never overlap.
+		void CreateOfferAsync(uint64_t id);
+		void OnOfferReplyAsync(uint64_t id, std::string type, std::string sdp);
+		void OnOfferRequestAsync(uint64_t id, std::string sdp);
 
 		bool ProcessMessages(int delay)
 		{
@@ -72,21 +232,53 @@ namespace Spitfire
 		void AddServerConfig(std::string uri, std::string username, std::string password);
 
 		void CreateDataChannel(const std::string & label, const webrtc::DataChannelInit dc_options);
+
+		// Declares a channel both peers create themselves with negotiated=true, so it opens together
+		// with SCTP instead of after a DCEP OPEN/ACK. Without an id, ids are handed out in declaration
+		// order, so both sides must declare the same channels in the same order.
+		void AddChannelTemplate(const std::string& label, webrtc::DataChannelInit options);
+		void ClearChannelTemplates();
+		void CreateTemplateChannels();
 		void DataChannelSendText(const std::string & label, const std::string & text);
 		RtcDataChannelInfo GetDataChannelInfo(const std::string& label);
 		webrtc::DataChannelInterface::DataState GetDataChannelState(const std::string& label);
 		void DataChannelSendData(const std::string & label, const webrtc::DataBuffer & data);
+		rtc::scoped_refptr<webrtc::DataChannelInterface> GetDataChannel(const std::string& label);
+
+		void SetDataChannelReceiveWindow(const std::string& label, RtcReceiveMode mode, uint64_t window);
+		void AcknowledgeDataMessages(const std::string& label, uint64_t bytes);
+		size_t DrainDataMessages(const std::string& label, std::vector<webrtc::DataBuffer>& messages, size_t max_messages);
+
+		void AddDataChannelRoute(const std::string& label, RtcConductor* destination, const std::string& destination_label);
+		void RemoveDataChannelRoute(const std::string& label, RtcConductor* destination, const std::string& destination_label);
+		void SetDataChannelForwardOnly(const std::string& label, bool forward_only);
+		RtcDataChannelRouteInfo GetDataChannelRouteInfo(const std::string& label, RtcConductor* destination, const std::string& destination_label);
+
+		void SubscribeTopic(const std::string& label, const std::string& topic, RtcTopicBackpressure policy, uint64_t max_queued_bytes);
+		void UnsubscribeTopic(const std::string& label, const std::string& topic);
+		void PublishDataChannel(const std::string& label, const std::string& topic, bool forward_only);
+		void UnpublishDataChannel(const std::string& label);
+
+		rtc::Thread* SignalingThread() const
+		{
+			return signaling_thread_;
+		}
 
 		OnErrorCallbackNative onError;
 		OnSuccessCallbackNative onSuccess;
+		OnCompactSuccessCallbackNative onCompactSuccess;
 		OnFailureCallbackNative onFailure;
+		OnNegotiationCompleteCallbackNative onNegotiationComplete;
 		OnIceStateChangeCallbackNative onIceStateChange;
+		OnPeerLostCallbackNative onPeerLost;
 		OnIceGatheringStateCallbackNative onIceGatheringStateChange;
 		OnIceCandidateCallbackNative onIceCandidate;
+		OnIceCandidatesCallbackNative onIceCandidates;
 		OnDataChannelStateCallbackNative onDataChannelState;
 		OnBufferAmountCallbackNative onBufferAmountChange;
 		OnDataMessageCallbackNative onDataMessage;
 		OnDataBinaryMessageCallbackNative onDataBinaryMessage;
+		OnDataChannelReceiveWindowCallbackNative onDataChannelReceiveWindow;
 
 		//rtc::scoped_refptr<Observers::DataChannelObserver> dataObserver;
 		rtc::scoped_refptr<Observers::PeerConnectionObserver> peerObserver;
@@ -108,14 +300,61 @@ namespace Spitfire
 		};
 
 	private:
-		rtc::Thread* worker_thread_;
-		rtc::Thread* signaling_thread_;
-		rtc::Thread* network_thread_;
-		std::unique_ptr<rtc::BasicNetworkManager> default_network_manager_;
+		rtc::Thread* owner_thread_ = nullptr;
+		rtc::Thread* worker_thread_ = nullptr;
+		rtc::Thread* signaling_thread_ = nullptr;
+		rtc::Thread* network_thread_ = nullptr;
+		int ice_candidate_pool_size_ = 0;
+		std::unique_ptr<rtc::NetworkManager> default_network_manager_;
 		std::unique_ptr<rtc::BasicPacketSocketFactory> default_socket_factory_;
+		RtcSocketBufferSizes socketBuffers_;
+		std::unique_ptr<rtc::PacketSocketFactory> mux_socket_factory_;
+		std::unique_ptr<rtc::PacketSocketFactory> probe_socket_factory_;
 
 		bool CreatePeerConnection(int minPort, int maxPort);
 
+		static webrtc::PeerConnectionInterface::RTCOfferAnswerOptions OfferOptions();
+		static webrtc::PeerConnectionInterface::RTCOfferAnswerOptions AnswerOptions();
+
+		void ChainNegotiation(uint64_t id, std::function<void(std::function<void()>)> operation);
+		void SetLocalDescriptionAsync(uint64_t id, webrtc::SessionDescriptionInterface* desc, std::function<void()> done);
+		void CompleteNegotiation(uint64_t id, bool success, const std::string& type, const std::string& sdp, const std::string& error);
+
+		rtc::scoped_refptr<rtc::OperationsChain> negotiations_;
+		bool compactSignaling_ = false;
+		bool iceLite_ = false;
+		bool measuredIceSelection_ = false;
+		std::shared_ptr<IceSelectionReport> iceSelection_;
+		RtcIceTiming iceTiming_;
+		int peerLostTimeoutMs_ = 0;
+		int peerLostGraceMs_ = 0;
+		// |iceTiming_| tightened to the peer lost bound, and the grace period left after it.
+		RtcIceTiming PeerLostTiming(int* grace_ms) const;
+		// Only touched on the signaling thread.
+		bool peerSilent_ = false;
+		bool peerLost_ = false;
+		uint32_t peerLostCheck_ = 0;
+		std::vector<std::pair<std::string, webrtc::DataChannelInit>> channelTemplates_;
+
+		bool batchIceCandidates_ = false;
+		int batchWindowMs_ = 0;
+		// Only touched on the signaling thread.
+		std::vector<RtcIceCandidate> pendingCandidates_;
+		uint32_t candidateBatch_ = 0;
+
+		void CompleteGathering(const char* reason);
+
+		RtcGatheringPolicy gatheringPolicy_;
+		// Servers this peer connection gathers from, the rest were pruned as stalled.
+		std::vector<std::string> gatheringServers_;
+		// Only touched on the signaling thread.
+		bool gatheringReported_ = false;
+		uint32_t gatheringRound_ = 0;
+		int64_t gatheringStartMs_ = 0;
+		// Servers that answered by candidate, the probe also sees answers whose candidate was dropped.
+		std::map<std::string, int64_t> serverResponses_;
+		ServerResponseProbe serverProbe_;
+
 		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> pc_factory_;
 		std::vector<webrtc::PeerConnectionInterface::IceServer> serverConfigs;
 		std::unique_ptr<cricket::RelayPortFactoryInterface> default_relay_port_factory_;
@@ -4,8 +4,16 @@
 void Spitfire::Observers::SetSessionDescriptionObserver::OnFailure(const std::string & error)
 {
 	//RTC_LOG(INFO) << __FUNCTION__;
+	if (completion_)
+	{
+		completion_(false, error);
+	}
 }
 void Spitfire::Observers::SetSessionDescriptionObserver::OnSuccess()
 {
 	//RTC_LOG(INFO) << __FUNCTION__;
+	if (completion_)
+	{
+		completion_(true, std::string());
+	}
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "rtc_base/ref_count.h"
 #include "rtc_base/ref_counted_object.h"
 
+#include <functional>
+
 namespace Spitfire 
 {
 	class RtcConductor;
@@ -13,10 +15,17 @@ namespace Spitfire
 		class SetSessionDescriptionObserver : public webrtc::SetSessionDescriptionObserver
 		{
 		public:
+			typedef std::function<void(bool success, const std::string & error)> Completion;
+
 			explicit SetSessionDescriptionObserver(RtcConductor* conductor) :
 				conductor_(conductor)
 			{
 			}
+			SetSessionDescriptionObserver(RtcConductor* conductor, Completion completion) :
+				conductor_(conductor),
+				completion_(std::move(completion))
+			{
+			}
 			~SetSessionDescriptionObserver() = default;
 
 			void OnSuccess() override;
@@ -40,6 +49,7 @@ namespace Spitfire
 		private:
 			mutable webrtc::webrtc_impl::RefCounter ref_count_{ 0 };
 			RtcConductor* conductor_;
+			Completion completion_;
 		};
 	}
 }
\ No newline at end of file
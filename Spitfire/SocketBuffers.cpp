@@ -0,0 +1,71 @@
+#include "SocketBuffers.h"
+#include "DnsCache.h"
+
+#include "rtc_base/logging.h"
+
+#if defined(WEBRTC_WIN)
+#include <winsock2.h>
+#include <iphlpapi.h>
+#endif
+
+namespace Spitfire
+{
+	bool SocketBuffers::Apply(rtc::AsyncPacketSocket* socket, const RtcSocketBufferSizes& sizes)
+	{
+		bool applied = true;
+		if (sizes.receive > 0 && socket->SetOption(rtc::Socket::OPT_RCVBUF, sizes.receive) < 0)
+		{
+			RTC_LOG(WARNING) << "Could not set a " << sizes.receive << " byte receive buffer on " << socket->GetLocalAddress().ToString();
+			applied = false;
+		}
+		if (sizes.send > 0 && socket->SetOption(rtc::Socket::OPT_SNDBUF, sizes.send) < 0)
+		{
+			RTC_LOG(WARNING) << "Could not set a " << sizes.send << " byte send buffer on " << socket->GetLocalAddress().ToString();
+			applied = false;
+		}
+		return applied;
+	}
+
+	bool SocketBuffers::GetKernelUdpInfo(RtcKernelUdpInfo* info)
+	{
+		*info = RtcKernelUdpInfo();
+#if defined(WEBRTC_WIN)
+		bool found = false;
+		for (ULONG family : { AF_INET, AF_INET6 })
+		{
+			MIB_UDPSTATS stats;
+			if (GetUdpStatisticsEx(&stats, family) != NO_ERROR)
+				continue;
+
+			info->datagramsReceived += stats.dwInDatagrams;
+			info->datagramsSent += stats.dwOutDatagrams;
+			info->receiveErrors += stats.dwInErrors;
+			info->noPorts += stats.dwNoPorts;
+			found = true;
+		}
+		return found;
+#else
+		return false;
+#endif
+	}
+
+	BufferedPacketSocketFactory::BufferedPacketSocketFactory(rtc::Thread* thread, const RtcSocketBufferSizes& sizes) :
+		rtc::BasicPacketSocketFactory(thread),
+		sizes_(sizes)
+	{
+	}
+
+	rtc::AsyncPacketSocket* BufferedPacketSocketFactory::CreateUdpSocket(const rtc::SocketAddress& local_address, uint16_t min_port, uint16_t max_port)
+	{
+		rtc::AsyncPacketSocket* socket = rtc::BasicPacketSocketFactory::CreateUdpSocket(local_address, min_port, max_port);
+		if (socket)
+			SocketBuffers::Apply(socket, sizes_);
+		return socket;
+	}
+
+	rtc::AsyncResolverInterface* BufferedPacketSocketFactory::CreateAsyncResolver()
+	{
+		rtc::AsyncResolverInterface* resolver = DnsCache::Instance().CreateResolver();
+		return resolver ? resolver : rtc::BasicPacketSocketFactory::CreateAsyncResolver();
+	}
+}
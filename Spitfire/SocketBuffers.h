@@ -0,0 +1,47 @@
+#pragma once
+
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "rtc_base/async_packet_socket.h"
+
+namespace Spitfire
+{
+	struct RtcSocketBufferSizes
+	{
+		// Zero keeps the OS default.
+		int receive = 0;
+		int send = 0;
+	};
+
+	// Host wide UDP counters. Windows keeps no per socket drop count, a datagram dropped
+	// because a socket's receive buffer was full shows up in receiveErrors.
+	struct RtcKernelUdpInfo
+	{
+		uint64_t datagramsReceived;
+		uint64_t datagramsSent;
+		uint64_t receiveErrors;
+		uint64_t noPorts;
+	};
+
+	class SocketBuffers
+	{
+	public:
+		// Returns false when the OS refused one of the sizes.
+		static bool Apply(rtc::AsyncPacketSocket* socket, const RtcSocketBufferSizes& sizes);
+		// Summed over IPv4 and IPv6.
+		static bool GetKernelUdpInfo(RtcKernelUdpInfo* info);
+	};
+
+	// Sizes the buffers of every UDP socket it creates, and resolves server names
+	// through the process wide DnsCache while it runs.
+	class BufferedPacketSocketFactory : public rtc::BasicPacketSocketFactory
+	{
+	public:
+		BufferedPacketSocketFactory(rtc::Thread* thread, const RtcSocketBufferSizes& sizes);
+
+		rtc::AsyncPacketSocket* CreateUdpSocket(const rtc::SocketAddress& local_address, uint16_t min_port, uint16_t max_port) override;
+		rtc::AsyncResolverInterface* CreateAsyncResolver() override;
+
+	private:
+		RtcSocketBufferSizes sizes_;
+	};
+}
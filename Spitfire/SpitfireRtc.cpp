@@ -8,6 +8,17 @@
 #include "rtc_base\helpers.h"
 
 #include "RtcConductor.h"
+#include "CertificateCache.h"
+#include "CertificatePool.h"
+#include "PeerConnectionPool.h"
+#include "CompactSdp.h"
+#include "UdpMux.h"
+#include "StunResponder.h"
+#include "TurnRelay.h"
+#include "TurnShare.h"
+#include "IceServerHealth.h"
+#include "NetworkEnumerator.h"
+#include "DnsCache.h"
 
 FILE _iob[] { *stdin, *stdout, *stderr };
 
@@ -25,6 +36,9 @@ using namespace System::Reflection;
 using namespace System;
 using namespace System::IO;
 using namespace System::Diagnostics;
+using namespace System::Threading;
+using namespace System::Threading::Tasks;
+using namespace System::Collections::Concurrent;
 using namespace msclr::interop;	
 
 [assembly:System::Runtime::Versioning::TargetFrameworkAttribute(L".NETFramework,Version=v4.0", FrameworkDisplayName = L".NET Framework 4")];
@@ -145,6 +159,38 @@ namespace Spitfire
 		Turn
 	};
 
+	/// <summary>
+	/// What happens to topic messages for a subscriber that cannot keep up.
+	/// </summary>
+	public enum class TopicBackpressure
+	{
+		/// <summary>
+		/// Messages are discarded until the subscriber's buffer drains.
+		/// </summary>
+		Drop,
+
+		/// <summary>
+		/// Messages are queued natively, up to a byte limit, until the subscriber's buffer drains.
+		/// </summary>
+		Queue
+	};
+
+	/// <summary>
+	/// How received data channel messages are handed to the application.
+	/// </summary>
+	public enum class DataChannelReceiveMode
+	{
+		/// <summary>
+		/// Messages are raised through OnDataMessage as they arrive.
+		/// </summary>
+		Callback,
+
+		/// <summary>
+		/// Messages are held natively until DrainDataMessages is called.
+		/// </summary>
+		Batched
+	};
+
 	public ref class ServerConfig
 	{
 	public:
@@ -186,6 +232,180 @@ namespace Spitfire
 		DataChannelState^ State;
 	};
 
+	public ref class DataChannelRouteInfo
+	{
+	public:
+		unsigned long long MessagesForwarded;
+		unsigned long long BytesForwarded;
+		unsigned long long MessagesDropped;
+	};
+
+	public ref class TopicInfo
+	{
+	public:
+		unsigned int Subscribers;
+		unsigned long long MessagesPublished;
+		unsigned long long MessagesDelivered;
+		unsigned long long MessagesDropped;
+		unsigned long long MessagesRateLimited;
+	};
+
+	public ref class CertificatePoolInfo
+	{
+	public:
+		unsigned int Ready;
+		unsigned long long Generated;
+		unsigned long long Hits;
+		unsigned long long Misses;
+	};
+
+	public ref class PeerConnectionPoolInfo
+	{
+	public:
+		unsigned int Idle;
+		unsigned long long Created;
+		unsigned long long Expired;
+		unsigned long long Hits;
+		unsigned long long Misses;
+	};
+
+	public ref class UdpMuxInfo
+	{
+	public:
+		unsigned int Shards;
+		unsigned int Sockets;
+		unsigned int Endpoints;
+		unsigned long long PacketsReceived;
+		unsigned long long PacketsSent;
+		unsigned long long PacketsDropped;
+		unsigned long long SendBatches;
+		unsigned long long ReceiveBatches;
+		unsigned long long SegmentedPackets;
+		unsigned long long CoalescedPackets;
+		unsigned long long SendBufferDrops;
+		unsigned long long StunResponses;
+	};
+
+	/// <summary>
+	/// Host wide UDP counters from the OS. ReceiveErrors includes datagrams dropped
+	/// because a socket's receive buffer was full.
+	/// </summary>
+	public ref class KernelUdpInfo
+	{
+	public:
+		unsigned long long DatagramsReceived;
+		unsigned long long DatagramsSent;
+		unsigned long long ReceiveErrors;
+		unsigned long long NoPorts;
+	};
+
+	public ref class TurnRelayInfo
+	{
+	public:
+		unsigned int Shards;
+		unsigned int Allocations;
+		unsigned long long BytesToPeers;
+		unsigned long long BytesFromPeers;
+		unsigned long long PacketsThrottled;
+	};
+
+	/// <summary>
+	/// Ports counts the relay ports of peer connections riding on the shared Allocations.
+	/// </summary>
+	public ref class TurnShareInfo
+	{
+	public:
+		unsigned int Allocations;
+		unsigned int Ports;
+		unsigned long long Peers;
+		unsigned long long PacketsSent;
+		unsigned long long PacketsReceived;
+		unsigned long long PacketsDropped;
+	};
+
+	public ref class NetworkEnumeratorInfo
+	{
+	public:
+		unsigned int Networks;
+		unsigned int Ignored;
+		unsigned int Subscribers;
+		unsigned long long Enumerations;
+	};
+
+	/// <summary>
+	/// Queries counts every server name a port asked for, Lookups the ones that reached the resolver.
+	/// </summary>
+	public ref class DnsCacheInfo
+	{
+	public:
+		unsigned int Entries;
+		unsigned long long Queries;
+		unsigned long long Lookups;
+		unsigned long long Failures;
+	};
+
+	/// <summary>
+	/// Named sets of ICE check intervals and timeouts, see SpitfireRtc::SetIceProfile.
+	/// </summary>
+	public enum class IceProfile
+	{
+		Default,
+		DatacenterLowLatency,
+		MobileBattery,
+		MassiveIdleFanIn
+	};
+
+	/// <summary>
+	/// ICE timing in milliseconds, unset values keep the WebRTC default.
+	/// </summary>
+	public ref class IceTiming
+	{
+	public:
+		Nullable<int> CheckIntervalStrong;
+		Nullable<int> CheckIntervalWeak;
+		Nullable<int> CheckMinInterval;
+		Nullable<int> UnwritableTimeout;
+		Nullable<int> UnwritableMinChecks;
+		Nullable<int> InactiveTimeout;
+		Nullable<int> StunKeepaliveInterval;
+		Nullable<int> ReceivingTimeout;
+	};
+
+	/// <summary>
+	/// Reports ICE gathering complete early, see SpitfireRtc::SetGatheringPolicy.
+	/// </summary>
+	public ref class GatheringPolicy
+	{
+	public:
+		bool FirstServerReflexive;
+		int DeadlineMs;
+		bool RelayNotNeeded;
+	};
+
+	public ref class IceServerHealthInfo
+	{
+	public:
+		unsigned int Servers;
+		unsigned int Pruned;
+		unsigned long long Skipped;
+	};
+
+	/// <summary>
+	/// The candidate pair measured ICE selection settled on, see SpitfireRtc::EnableMeasuredIceSelection.
+	/// Loss is the share of unanswered checks, from 0 to 1.
+	/// </summary>
+	public ref class IceSelectionInfo
+	{
+	public:
+		String^ Local;
+		String^ Remote;
+		int RttMs;
+		int JitterMs;
+		double Loss;
+		String^ Reason;
+		unsigned int Switches;
+	};
+
 	public ref class SpitfireSdp
 	{
 	public:
@@ -193,6 +413,36 @@ namespace Spitfire
 		SdpTypes Type;
 	};
 
+	// Completes a negotiation task from the thread pool so awaiting code never continues inline on
+	// the signaling thread. RunContinuationsAsynchronously would do the same but needs .NET 4.6.
+	ref class NegotiationCompletion
+	{
+	public:
+		NegotiationCompletion(TaskCompletionSource<SpitfireSdp^>^ completion, SpitfireSdp^ result, String^ error) :
+			completion_(completion), result_(result), error_(error)
+		{
+		}
+
+		void Post()
+		{
+			ThreadPool::QueueUserWorkItem(gcnew WaitCallback(this, &NegotiationCompletion::Complete));
+		}
+
+	private:
+		void Complete(Object^ state)
+		{
+			// Dispose may have cancelled the task in the meantime.
+			if(result_ != nullptr)
+				completion_->TrySetResult(result_);
+			else
+				completion_->TrySetException(gcnew InvalidOperationException(error_));
+		}
+
+		TaskCompletionSource<SpitfireSdp^>^ completion_;
+		SpitfireSdp^ result_;
+		String^ error_;
+	};
+
 	public ref class SpitfireFailure
 	{
 	public:
@@ -276,6 +526,10 @@ namespace Spitfire
 		_OnSuccessCallback^ onSuccess;
 		GCHandle^ onSuccessHandle;
 
+		delegate void _OnCompactSuccessCallback(String^ type, uint8_t* data, uint32_t size);
+		_OnCompactSuccessCallback^ onCompactSuccess;
+		GCHandle^ onCompactSuccessHandle;
+
 		delegate void _OnFailureCallback(String^ error);
 		_OnFailureCallback^ onFailure;
 		GCHandle^ onFailureHandle;
@@ -292,6 +546,10 @@ namespace Spitfire
 		_OnIceCandidateCallback^ onIceCandidate;
 		GCHandle^ onIceCandidateHandle;
 
+		delegate void _OnIceCandidatesCallback(Spitfire::RtcIceCandidate* candidates, uint32_t count);
+		_OnIceCandidatesCallback^ onIceCandidates;
+		GCHandle^ onIceCandidatesHandle;
+
 		delegate void _OnDataChannelStateCallback(String^ label, webrtc::DataChannelInterface::DataState state);
 		_OnDataChannelStateCallback^ onDataChannelStateChange;
 		GCHandle^ onDataChannelStateHandle;
@@ -300,10 +558,25 @@ namespace Spitfire
 		_OnBufferChangeCallback^ onBufferAmountChange;
 		GCHandle^ onBufferAmountChangeHandle;
 
+		delegate void _OnDataChannelReceiveWindowCallback(String^ label, bool paused, uint64_t pendingBytes);
+		_OnDataChannelReceiveWindowCallback^ onDataChannelReceiveWindow;
+		GCHandle^ onDataChannelReceiveWindowHandle;
+
+		delegate void _OnNegotiationCompleteCallback(uint64_t id, bool success, String^ type, String^ sdp, String^ error);
+		_OnNegotiationCompleteCallback^ onNegotiationComplete;
+		GCHandle^ onNegotiationCompleteHandle;
+
+		Int64 nextNegotiationId_;
+		ConcurrentDictionary<UInt64, TaskCompletionSource<SpitfireSdp^>^>^ negotiations_;
+
 		delegate void _OnIceStateCallback(webrtc::PeerConnectionInterface::IceConnectionState state);
 		_OnIceStateCallback^ onIceStateChange;
 		GCHandle^ onIceStateCallbackHandle;
 
+		delegate void _OnPeerLostCallback(String^ reason);
+		_OnPeerLostCallback^ onPeerLost;
+		GCHandle^ onPeerLostHandle;
+
 		delegate void _OnIceGatheringStateCallback(webrtc::PeerConnectionInterface::IceGatheringState state);
 		_OnIceGatheringStateCallback^ onIceGatheringStateChange;
 		GCHandle^ onIceGatheringStateCallbackHandle;
@@ -339,6 +612,25 @@ namespace Spitfire
 			}
 		}
 
+		void _OnCompactSuccess(String^ type, uint8_t* data, uint32_t size)
+		{
+			array<Byte>^ data_array = gcnew array<Byte>(size);
+			Marshal::Copy(IntPtr(data), data_array, 0, size);
+
+			if(type == "offer")
+				OnSuccessCompactOffer(data_array);
+			else if(type == "answer")
+				OnSuccessCompactAnswer(data_array);
+		}
+
+		static std::string ToNativeBytes(array<Byte>^ data)
+		{
+			if(data == nullptr || data->Length == 0)
+				return std::string();
+			pin_ptr<Byte> pinned = &data[0];
+			return std::string(reinterpret_cast<const char*>(pinned), data->Length);
+		}
+
 		void _OnIceCandidate(String^ sdp_mid, Int32 sdp_mline_index, String^ sdp)
 		{
 			auto ice = gcnew SpitfireIceCandidate();
@@ -348,6 +640,20 @@ namespace Spitfire
 			OnIceCandidate(ice);
 		}
 
+		void _OnIceCandidates(Spitfire::RtcIceCandidate* candidates, uint32_t count)
+		{
+			auto batch = gcnew array<SpitfireIceCandidate^>(count);
+			for(uint32_t i = 0; i < count; i++)
+			{
+				auto ice = gcnew SpitfireIceCandidate();
+				ice->Sdp = gcnew String(candidates[i].sdp.c_str());
+				ice->SdpMid = gcnew String(candidates[i].sdpMid.c_str());
+				ice->SdpIndex = candidates[i].sdpMlineIndex;
+				batch[i] = ice;
+			}
+			OnIceCandidates(batch);
+		}
+
 		void _OnFailure(String^ error)
 		{
 			OnFailure(error);
@@ -363,6 +669,33 @@ namespace Spitfire
 			OnDataMessage(label, message);
 		}
 
+		void _OnNegotiationComplete(uint64_t id, bool success, String^ type, String^ sdp, String^ error)
+		{
+			TaskCompletionSource<SpitfireSdp^>^ completion;
+			if(!negotiations_->TryRemove(id, completion))
+				return;
+
+			if(!success)
+			{
+				(gcnew NegotiationCompletion(completion, nullptr, error))->Post();
+				return;
+			}
+
+			auto sdpModel = gcnew SpitfireSdp();
+			sdpModel->Type = type == "offer" ? SdpTypes::Offer : SdpTypes::Answer;
+			sdpModel->Sdp = sdp;
+			(gcnew NegotiationCompletion(completion, sdpModel, nullptr))->Post();
+		}
+
+		TaskCompletionSource<SpitfireSdp^>^ BeginNegotiation(UInt64% id)
+		{
+			// Completions arrive on the signaling thread and are handed to the thread pool.
+			auto completion = gcnew TaskCompletionSource<SpitfireSdp^>();
+			id = static_cast<UInt64>(Interlocked::Increment(nextNegotiationId_));
+			negotiations_[id] = completion;
+			return completion;
+		}
+
 		void _OnIceState(webrtc::PeerConnectionInterface::IceConnectionState state)
 		{
 
@@ -370,6 +703,11 @@ namespace Spitfire
 			OnIceStateChange(managedState);
 		}
 
+		void _OnPeerLost(String^ reason)
+		{
+			OnPeerLost(reason);
+		}
+
 		void _OnIceGatheringState(webrtc::PeerConnectionInterface::IceGatheringState state)
 		{
 			IceGatheringState managedState = static_cast<IceGatheringState>(state);
@@ -406,6 +744,82 @@ namespace Spitfire
 			OnDataMessage(label, message);
 		}
 
+		void _OnDataChannelReceiveWindow(String^ label, bool paused, uint64_t pendingBytes)
+		{
+			OnDataChannelReceiveWindow(label, paused, static_cast<long long>(pendingBytes));
+		}
+
+		static Spitfire::DataMessage^ ToDataMessage(const webrtc::DataBuffer& buffer)
+		{
+			auto message = gcnew Spitfire::DataMessage();
+			message->IsBinary = buffer.binary;
+			message->IsText = !buffer.binary;
+			if(buffer.binary)
+			{
+				array<Byte>^ data_array = gcnew array<Byte>(static_cast<int>(buffer.size()));
+				IntPtr src(const_cast<uint8_t*>(buffer.data.data()));
+				Marshal::Copy(src, data_array, 0, static_cast<int>(buffer.size()));
+				message->RawData = data_array;
+			}
+			else
+			{
+				message->Data = marshal_as<String^>(std::string(buffer.data.data<char>(), buffer.size()));
+			}
+			return message;
+		}
+
+		static void ToNativeServerConfig(ServerConfig^ config, std::string& hostUri, std::string& username, std::string& password)
+		{
+			String^ type = config->Type == ServerType::Stun ? "stun" : "turn";
+			hostUri = marshal_as<std::string>(type + ":" + config->Host + ":" + config->Port);
+			auto u = config->Username;
+			username = String::IsNullOrWhiteSpace(u) ? "" : marshal_as<std::string>(u);
+			auto p = config->Password;
+			password = String::IsNullOrWhiteSpace(p) ? "" : marshal_as<std::string>(p);
+		}
+
+		static webrtc::DataChannelInit ToNativeOptions(DataChannelOptions^ dataChannelOptions)
+		{
+			auto protocol = dataChannelOptions->Protocol;
+
+			webrtc::DataChannelInit dc_options;
+			dc_options.id = dataChannelOptions->Id;
+			if(dataChannelOptions->MaxRetransmits.HasValue) {
+				dc_options.maxRetransmits.emplace(dataChannelOptions->MaxRetransmits.Value);
+			}
+			if(dataChannelOptions->MaxRetransmitTime.HasValue) {
+				dc_options.maxRetransmitTime.emplace(dataChannelOptions->MaxRetransmitTime.Value);
+			}
+			dc_options.negotiated = dataChannelOptions->Negotiated;
+			dc_options.ordered = dataChannelOptions->Ordered;
+			if(!String::IsNullOrWhiteSpace(protocol))
+			{
+				dc_options.protocol = marshal_as<std::string>(protocol);
+			}
+			dc_options.reliable = dataChannelOptions->Reliable;
+			return dc_options;
+		}
+
+		bool ClaimPooledPeerConnection()
+		{
+			// Pooled connections gather with the full allocator and default ICE timing, which
+			// libwebrtc does not let us change on an existing peer connection.
+			if(!Spitfire::PeerConnectionPool::Instance().IsRunning() || conductor_->get()->IsIceLite() || conductor_->get()->IsMeasuredIceSelection() ||
+				!conductor_->get()->GetIceTiming().IsDefault() || conductor_->get()->GetPeerLostTimeout() > 0)
+				return false;
+
+			auto pooled = Spitfire::PeerConnectionPool::Instance().Claim();
+			if(!pooled)
+				return false;
+
+			// The pooled conductor takes over the settings and the calling thread's message loop.
+			pooled->AdoptSettings(*conductor_->get());
+			pooled->AttachOwnerThread();
+			pooled->CreateTemplateChannels();
+			conductor_->reset(pooled.release());
+			return true;
+		}
+
 		void Initialize(int min_port, int max_port)
 		{
 			disposed_ = false;
@@ -421,6 +835,10 @@ namespace Spitfire
 			onSuccessHandle = GCHandle::Alloc(onSuccess);
 			conductor_->get()->onSuccess = static_cast<Spitfire::OnSuccessCallbackNative>(Marshal::GetFunctionPointerForDelegate(onSuccess).ToPointer());
 
+			onCompactSuccess = gcnew _OnCompactSuccessCallback(this, &SpitfireRtc::_OnCompactSuccess);
+			onCompactSuccessHandle = GCHandle::Alloc(onCompactSuccess);
+			conductor_->get()->onCompactSuccess = static_cast<Spitfire::OnCompactSuccessCallbackNative>(Marshal::GetFunctionPointerForDelegate(onCompactSuccess).ToPointer());
+
 			onFailure = gcnew _OnFailureCallback(this, &SpitfireRtc::_OnFailure);
 			onFailureHandle = GCHandle::Alloc(onFailure);
 			conductor_->get()->onFailure = static_cast<Spitfire::OnFailureCallbackNative>(Marshal::GetFunctionPointerForDelegate(onFailure).ToPointer());
@@ -437,6 +855,10 @@ namespace Spitfire
 			onIceCandidateHandle = GCHandle::Alloc(onIceCandidate);
 			conductor_->get()->onIceCandidate = static_cast<Spitfire::OnIceCandidateCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceCandidate).ToPointer());
 
+			onIceCandidates = gcnew _OnIceCandidatesCallback(this, &SpitfireRtc::_OnIceCandidates);
+			onIceCandidatesHandle = GCHandle::Alloc(onIceCandidates);
+			conductor_->get()->onIceCandidates = static_cast<Spitfire::OnIceCandidatesCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceCandidates).ToPointer());
+
 			onDataChannelStateChange = gcnew _OnDataChannelStateCallback(this, &SpitfireRtc::_OnDataChannelState);
 			onDataChannelStateHandle = GCHandle::Alloc(onDataChannelStateChange);
 			conductor_->get()->onDataChannelState = static_cast<Spitfire::OnDataChannelStateCallbackNative>(Marshal::GetFunctionPointerForDelegate(onDataChannelStateChange).ToPointer());
@@ -445,6 +867,10 @@ namespace Spitfire
 			onIceStateCallbackHandle = GCHandle::Alloc(onIceStateChange);
 			conductor_->get()->onIceStateChange = static_cast<Spitfire::OnIceStateChangeCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceStateChange).ToPointer());
 
+			onPeerLost = gcnew _OnPeerLostCallback(this, &SpitfireRtc::_OnPeerLost);
+			onPeerLostHandle = GCHandle::Alloc(onPeerLost);
+			conductor_->get()->onPeerLost = static_cast<Spitfire::OnPeerLostCallbackNative>(Marshal::GetFunctionPointerForDelegate(onPeerLost).ToPointer());
+
 			onIceGatheringStateChange = gcnew _OnIceGatheringStateCallback(this, &SpitfireRtc::_OnIceGatheringState);
 			onIceGatheringStateCallbackHandle = GCHandle::Alloc(onIceGatheringStateChange);
 			conductor_->get()->onIceGatheringStateChange = static_cast<Spitfire::OnIceGatheringStateCallbackNative>(Marshal::GetFunctionPointerForDelegate(onIceGatheringStateChange).ToPointer());
@@ -452,6 +878,16 @@ namespace Spitfire
 			onBufferAmountChange = gcnew _OnBufferChangeCallback(this, &SpitfireRtc::_OnBufferAmountChange);
 			onBufferAmountChangeHandle = GCHandle::Alloc(onBufferAmountChange);
 			conductor_->get()->onBufferAmountChange = static_cast<Spitfire::OnBufferAmountCallbackNative>(Marshal::GetFunctionPointerForDelegate(onBufferAmountChange).ToPointer());
+
+			onDataChannelReceiveWindow = gcnew _OnDataChannelReceiveWindowCallback(this, &SpitfireRtc::_OnDataChannelReceiveWindow);
+			onDataChannelReceiveWindowHandle = GCHandle::Alloc(onDataChannelReceiveWindow);
+			conductor_->get()->onDataChannelReceiveWindow = static_cast<Spitfire::OnDataChannelReceiveWindowCallbackNative>(Marshal::GetFunctionPointerForDelegate(onDataChannelReceiveWindow).ToPointer());
+
+			nextNegotiationId_ = 0;
+			negotiations_ = gcnew ConcurrentDictionary<UInt64, TaskCompletionSource<SpitfireSdp^>^>();
+			onNegotiationComplete = gcnew _OnNegotiationCompleteCallback(this, &SpitfireRtc::_OnNegotiationComplete);
+			onNegotiationCompleteHandle = GCHandle::Alloc(onNegotiationComplete);
+			conductor_->get()->onNegotiationComplete = static_cast<Spitfire::OnNegotiationCompleteCallbackNative>(Marshal::GetFunctionPointerForDelegate(onNegotiationComplete).ToPointer());
 		}
 
 	public:
@@ -459,9 +895,23 @@ namespace Spitfire
 		event OnCallbackSdp^ OnSuccessOffer;
 		event OnCallbackSdp^ OnSuccessAnswer;
 
+		delegate void OnCallbackCompactSdp(array<Byte>^ data);
+		/// <summary>
+		/// Raised instead of OnSuccessOffer/OnSuccessAnswer for data channel only sessions once
+		/// EnableCompactSignaling is on. The payload is the compact binary description.
+		/// </summary>
+		event OnCallbackCompactSdp^ OnSuccessCompactOffer;
+		event OnCallbackCompactSdp^ OnSuccessCompactAnswer;
+
 		delegate void OnCallbackIceCandidate(SpitfireIceCandidate^ iceCandidate);
 		event OnCallbackIceCandidate^ OnIceCandidate;
 
+		delegate void OnCallbackIceCandidates(array<SpitfireIceCandidate^>^ iceCandidates);
+		/// <summary>
+		/// Raised instead of OnIceCandidate with a whole batch once EnableIceCandidateBatching is on.
+		/// </summary>
+		event OnCallbackIceCandidates^ OnIceCandidates;
+
 		event Action^ OnError;
 
 		delegate void DataChannelOpen(String^ label);
@@ -491,6 +941,13 @@ namespace Spitfire
 		/// </summary>
 		event IceStateChange^ OnIceStateChange;
 
+		delegate void PeerLost(String^ reason);
+		/// <summary>
+		/// Raised once when the remote peer is considered gone, see SetPeerLostTimeout.
+		/// The reason is "timeout" when nothing was heard within the bound, or "failed" when ICE failed.
+		/// </summary>
+		event PeerLost^ OnPeerLost;
+
 		delegate void IceGatheringStateChange(IceGatheringState msg);
 		/// <summary>
 		/// When ICE firststarts to gather connection candidates, the value changes from new to gathering to indicate that the process of collecting candidate 
@@ -506,6 +963,13 @@ namespace Spitfire
 		/// </summary>
 		event BufferChange^ OnBufferAmountChange;
 
+		delegate void DataChannelReceiveWindow(String^ label, bool paused, long long pendingBytes);
+		/// <summary>
+		/// Raised when a data channel's receive window fills up (paused) and when it has room again.
+		/// While paused, received messages are held natively instead of being delivered.
+		/// </summary>
+		event DataChannelReceiveWindow^ OnDataChannelReceiveWindow;
+
 		SpitfireRtc()
 		{
 			Initialize(1025, 65535);
@@ -523,15 +987,25 @@ namespace Spitfire
 			FreeGCHandle(onErrorHandle);
 			FreeGCHandle(onSuccessHandle);
 			FreeGCHandle(onFailureHandle);
+			FreeGCHandle(onCompactSuccessHandle);
 			FreeGCHandle(onIceCandidateHandle);
+			FreeGCHandle(onIceCandidatesHandle);
 			FreeGCHandle(onDataMessageHandle);
 			FreeGCHandle(onIceGatheringStateCallbackHandle);
+			FreeGCHandle(onPeerLostHandle);
 			FreeGCHandle(onDataBinaryMessageHandle);
 			FreeGCHandle(onDataChannelStateHandle);
+			FreeGCHandle(onDataChannelReceiveWindowHandle);
 			if(conductor_)
 			{
 				conductor_->get()->DeletePeerConnection();
 			}
+			FreeGCHandle(onNegotiationCompleteHandle);
+			for each(auto pending in negotiations_->Values)
+			{
+				pending->TrySetCanceled();
+			}
+			negotiations_->Clear();
 
 			this->!SpitfireRtc(); // call finalizer
 
@@ -567,85 +1041,718 @@ namespace Spitfire
 		}
 
 		/// <summary>
-		/// Creates a peer connection, call InitializeSSL before calling this.
+		/// Shares one ECDSA DTLS certificate between every peer connection created afterwards,
+		/// instead of generating a key pair per peer. Set rotationMinutes to replace it on a schedule, zero keeps it until it nears expiry.
 		/// </summary>
-		bool InitializePeerConnection()
-		{
-			return conductor_->get()->InitializePeerConnection(min_port_, max_port_);
-		}
-
-		void CreateOffer()
+		static void EnableCertificateCache(bool enabled, int rotationMinutes)
 		{
-			conductor_->get()->CreateOffer();
+			Spitfire::CertificateCache::Instance().SetRotationInterval(static_cast<uint64_t>(rotationMinutes) * 60 * 1000);
+			Spitfire::CertificateCache::Instance().SetEnabled(enabled);
 		}
 
 		/// <summary>
-		/// Run this within a loop to process signaling messages for your peer.
+		/// Generates distinct DTLS certificates ahead of demand on a background thread,
+		/// refilling the pool once it drops to lowWater. Ignored while the certificate cache is enabled.
 		/// </summary>
-		bool ProcessMessages(Int32 delay)
+		static void StartCertificatePool(int capacity, int lowWater)
 		{
-			return conductor_->get()->ProcessMessages(delay);
+			Spitfire::CertificatePool::Instance().Start(static_cast<size_t>(capacity), static_cast<size_t>(lowWater));
 		}
 
-		void SetOfferReply(String^ type, String^ sdp)
+		static void StopCertificatePool()
 		{
-			conductor_->get()->OnOfferReply(marshal_as<std::string>(type), marshal_as<std::string>(sdp));
+			Spitfire::CertificatePool::Instance().Stop();
 		}
 
 		/// <summary>
-		/// Provides an offer to your peer connection from a remote peer
-		/// This is used to setup the data channel between two peers. 
+		/// Returns a snapshot of the certificate pool, a miss means a peer had to generate its own certificate.
 		/// </summary>
-		void SetOfferRequest(String^ sdp)
+		static Spitfire::CertificatePoolInfo^ GetCertificatePoolInfo()
 		{
-			conductor_->get()->OnOfferRequest(marshal_as<std::string>(sdp));
+			auto rtcInfo = Spitfire::CertificatePool::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::CertificatePoolInfo();
+			managedInfo->Ready = rtcInfo.ready;
+			managedInfo->Generated = rtcInfo.generated;
+			managedInfo->Hits = rtcInfo.hits;
+			managedInfo->Misses = rtcInfo.misses;
+			return managedInfo;
 		}
 
-		bool AddIceCandidate(String^ sdp_mid, Int32 sdp_mlineindex, String^ sdp)
+		/// <summary>
+		/// Configures the pool of pre-warmed peer connections. Pooled connections use the pool's port range
+		/// and servers rather than the ones given to the claiming SpitfireRtc.
+		/// iceCandidatePoolSize lets idle connections gather candidates ahead of time,
+		/// idle connections older than idleExpirySeconds are replaced (zero keeps them).
+		/// </summary>
+		static void ConfigurePeerConnectionPool(int size, int minPort, int maxPort, int iceCandidatePoolSize, int idleExpirySeconds)
 		{
-			return conductor_->get()->AddIceCandidate(marshal_as<std::string>(sdp_mid), sdp_mlineindex, marshal_as<std::string>(sdp));
+			if (size < 0)
+				throw gcnew ArgumentOutOfRangeException("size");
+			if (idleExpirySeconds < 0)
+				throw gcnew ArgumentOutOfRangeException("idleExpirySeconds");
+
+			Spitfire::PeerConnectionPool::Instance().Configure(static_cast<size_t>(size), minPort, maxPort, iceCandidatePoolSize, static_cast<int64_t>(idleExpirySeconds) * 1000);
 		}
 
-		void AddServerConfig(ServerConfig^ config)
+		static void AddPeerConnectionPoolServer(ServerConfig^ config)
 		{
-			String^ type = config->Type == ServerType::Stun ? "stun" : "turn";
-			auto hostUri = marshal_as<std::string>(type + ":" + config->Host + ":" + config->Port);
-			auto u = config->Username;
-			auto username = String::IsNullOrWhiteSpace(u) ? "" : marshal_as<std::string>(u);
-			auto p = config->Password;
-			auto password = String::IsNullOrWhiteSpace(p) ? "" : marshal_as<std::string>(p);
-			conductor_->get()->AddServerConfig(hostUri, username, password);
+			std::string hostUri, username, password;
+			ToNativeServerConfig(config, hostUri, username, password);
+			Spitfire::PeerConnectionPool::Instance().AddServerConfig(hostUri, username, password);
 		}
+
 		/// <summary>
-		/// Creates a data channel from within the application.
-		/// Only call if your application is setting up the connection and preparing to offer.
+		/// Starts filling the pool. Once running, InitializePeerConnection and SetOfferRequest
+		/// claim an idle connection when one is available, call InitializeSSL before calling this.
 		/// </summary>
-		void CreateDataChannel(DataChannelOptions^ dataChannelOptions)
+		static void StartPeerConnectionPool()
 		{
-			auto label = dataChannelOptions->Label;
-			auto protocol = dataChannelOptions->Protocol;
+			Spitfire::PeerConnectionPool::Instance().Start();
+		}
 
-			webrtc::DataChannelInit dc_options;
-			dc_options.id = dataChannelOptions->Id;
-			if(dataChannelOptions->MaxRetransmits.HasValue) {
-				dc_options.maxRetransmits.emplace(dataChannelOptions->MaxRetransmits.Value);
-			}
-			if(dataChannelOptions->MaxRetransmitTime.HasValue) {
-				dc_options.maxRetransmitTime.emplace(dataChannelOptions->MaxRetransmitTime.Value);
-			}
-			dc_options.negotiated = dataChannelOptions->Negotiated;
-			dc_options.ordered = dataChannelOptions->Ordered;
-			if(!String::IsNullOrWhiteSpace(protocol))
-			{
-				dc_options.protocol = marshal_as<std::string>(protocol);
-			}
-			dc_options.reliable = dataChannelOptions->Reliable;
-			conductor_->get()->CreateDataChannel(marshal_as<std::string>(label), dc_options);
+		static void StopPeerConnectionPool()
+		{
+			Spitfire::PeerConnectionPool::Instance().Stop();
 		}
+
 		/// <summary>
-		/// Send your text through the data channel
+		/// Returns a snapshot of the peer connection pool, a miss means a peer was created on demand.
 		/// </summary>
-		void DataChannelSendText(String^ label, String^ text)
+		static Spitfire::PeerConnectionPoolInfo^ GetPeerConnectionPoolInfo()
+		{
+			auto rtcInfo = Spitfire::PeerConnectionPool::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::PeerConnectionPoolInfo();
+			managedInfo->Idle = rtcInfo.idle;
+			managedInfo->Created = rtcInfo.created;
+			managedInfo->Expired = rtcInfo.expired;
+			managedInfo->Hits = rtcInfo.hits;
+			managedInfo->Misses = rtcInfo.misses;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Serves the UDP candidates of every peer connection created afterwards from this one
+		/// port per local address, instead of binding sockets from each peer's port range.
+		/// Returns false if the mux is already running on another port.
+		/// </summary>
+		static bool StartUdpMux(int port)
+		{
+			return Spitfire::UdpMux::Instance().Start(static_cast<uint16_t>(port));
+		}
+
+		/// <summary>
+		/// Runs the mux as several shards, each with its own thread on port + i, for hosts
+		/// where one mux thread cannot keep up. Every peer connection is served by one shard, its
+		/// packets are batched over to and from the peer's own network thread.
+		/// </summary>
+		static bool StartUdpMux(int port, int shards)
+		{
+			if(shards < 1)
+				return false;
+			return Spitfire::UdpMux::Instance().Start(static_cast<uint16_t>(port), static_cast<size_t>(shards));
+		}
+
+		static void StopUdpMux()
+		{
+			Spitfire::UdpMux::Instance().Stop();
+		}
+
+		/// <summary>
+		/// UDP segmentation offload (USO/URO) for mux sockets bound afterwards, on by default.
+		/// Bursts to one peer leave in a single send where Windows supports it.
+		/// </summary>
+		static void SetUdpMuxOffload(bool enabled)
+		{
+			Spitfire::UdpMux::Instance().SetSegmentationOffload(enabled);
+		}
+
+		/// <summary>
+		/// Answers plain STUN binding requests on the mux ports, so clients can use
+		/// stun:thishost:muxport instead of an external STUN server. Call before StartUdpMux.
+		/// </summary>
+		static void SetUdpMuxStunResponder(bool enabled)
+		{
+			Spitfire::UdpMux::Instance().SetStunResponder(enabled);
+		}
+
+		/// <summary>
+		/// Runs a STUN server on its own port for deployments without the UDP mux.
+		/// Returns false if the port cannot be bound or the server runs on another port.
+		/// </summary>
+		static bool StartStunServer(int port)
+		{
+			return Spitfire::StunResponder::Instance().Start(static_cast<uint16_t>(port));
+		}
+
+		static void StopStunServer()
+		{
+			Spitfire::StunResponder::Instance().Stop();
+		}
+
+		/// <summary>
+		/// Runs a TURN relay in this process on UDP port + i for each of |shards| threads.
+		/// Relayed addresses are allocated on |externalIp|, which has to be a local address.
+		/// Add users first, allocations with unknown credentials are rejected.
+		/// </summary>
+		static bool StartTurnRelay(int port, String^ externalIp, int shards)
+		{
+			if(port < 1 || shards < 1 || String::IsNullOrWhiteSpace(externalIp))
+				return false;
+			return Spitfire::TurnRelay::Instance().Start(static_cast<uint16_t>(port), marshal_as<std::string>(externalIp), static_cast<size_t>(shards));
+		}
+
+		static void StopTurnRelay()
+		{
+			Spitfire::TurnRelay::Instance().Stop();
+		}
+
+		static void AddTurnRelayUser(String^ username, String^ password)
+		{
+			Spitfire::TurnRelay::Instance().AddUser(marshal_as<std::string>(username), marshal_as<std::string>(password));
+		}
+
+		static void RemoveTurnRelayUser(String^ username)
+		{
+			Spitfire::TurnRelay::Instance().RemoveUser(marshal_as<std::string>(username));
+		}
+
+		/// <summary>
+		/// Realm of the relay's long term credentials, "spitfire" by default. Call before StartTurnRelay.
+		/// </summary>
+		static void SetTurnRelayRealm(String^ realm)
+		{
+			Spitfire::TurnRelay::Instance().SetRealm(marshal_as<std::string>(realm));
+		}
+
+		/// <summary>
+		/// Caps each allocation at this many bytes per second in each direction, 0 for no limit.
+		/// Packets over the limit are dropped. Call before StartTurnRelay.
+		/// </summary>
+		static void SetTurnRelayRateLimit(int bytesPerSecond)
+		{
+			Spitfire::TurnRelay::Instance().SetAllocationRateLimit(bytesPerSecond);
+		}
+
+		static Spitfire::TurnRelayInfo^ GetTurnRelayInfo()
+		{
+			auto rtcInfo = Spitfire::TurnRelay::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::TurnRelayInfo();
+			managedInfo->Shards = rtcInfo.shards;
+			managedInfo->Allocations = rtcInfo.allocations;
+			managedInfo->BytesToPeers = rtcInfo.bytesToPeers;
+			managedInfo->BytesFromPeers = rtcInfo.bytesFromPeers;
+			managedInfo->PacketsThrottled = rtcInfo.packetsThrottled;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Peer connections created afterwards share one allocation per UDP TURN server and
+		/// credentials, instead of allocating their own. Saves an allocation round trip per
+		/// peer and server load, at the cost of a thread hop for relayed packets.
+		/// </summary>
+		static void StartTurnShare()
+		{
+			Spitfire::TurnShare::Instance().Start();
+		}
+
+		static void StopTurnShare()
+		{
+			Spitfire::TurnShare::Instance().Stop();
+		}
+
+		static Spitfire::TurnShareInfo^ GetTurnShareInfo()
+		{
+			auto rtcInfo = Spitfire::TurnShare::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::TurnShareInfo();
+			managedInfo->Allocations = rtcInfo.allocations;
+			managedInfo->Ports = rtcInfo.ports;
+			managedInfo->Peers = rtcInfo.peers;
+			managedInfo->PacketsSent = rtcInfo.packetsSent;
+			managedInfo->PacketsReceived = rtcInfo.packetsReceived;
+			managedInfo->PacketsDropped = rtcInfo.packetsDropped;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Socket buffer sizes in bytes for the mux's shared sockets, 0 keeps the OS default.
+		/// Call before StartUdpMux.
+		/// </summary>
+		static void SetUdpMuxBufferSizes(int receiveBytes, int sendBytes)
+		{
+			Spitfire::RtcSocketBufferSizes buffers;
+			buffers.receive = receiveBytes;
+			buffers.send = sendBytes;
+			Spitfire::UdpMux::Instance().SetSocketBufferSizes(buffers);
+		}
+
+		/// <summary>
+		/// Returns the host's UDP counters, or null where the OS does not provide them.
+		/// ReceiveErrors growing while peers report loss points at local overload.
+		/// </summary>
+		static Spitfire::KernelUdpInfo^ GetKernelUdpInfo()
+		{
+			Spitfire::RtcKernelUdpInfo rtcInfo;
+			if(!Spitfire::SocketBuffers::GetKernelUdpInfo(&rtcInfo))
+				return nullptr;
+
+			auto managedInfo = gcnew Spitfire::KernelUdpInfo();
+			managedInfo->DatagramsReceived = rtcInfo.datagramsReceived;
+			managedInfo->DatagramsSent = rtcInfo.datagramsSent;
+			managedInfo->ReceiveErrors = rtcInfo.receiveErrors;
+			managedInfo->NoPorts = rtcInfo.noPorts;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Returns a snapshot of the UDP mux, dropped packets matched no peer connection.
+		/// </summary>
+		static Spitfire::UdpMuxInfo^ GetUdpMuxInfo()
+		{
+			auto rtcInfo = Spitfire::UdpMux::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::UdpMuxInfo();
+			managedInfo->Shards = rtcInfo.shards;
+			managedInfo->Sockets = rtcInfo.sockets;
+			managedInfo->Endpoints = rtcInfo.endpoints;
+			managedInfo->PacketsReceived = rtcInfo.packetsReceived;
+			managedInfo->PacketsSent = rtcInfo.packetsSent;
+			managedInfo->PacketsDropped = rtcInfo.packetsDropped;
+			managedInfo->SendBatches = rtcInfo.sendBatches;
+			managedInfo->ReceiveBatches = rtcInfo.receiveBatches;
+			managedInfo->SegmentedPackets = rtcInfo.segmentedPackets;
+			managedInfo->CoalescedPackets = rtcInfo.coalescedPackets;
+			managedInfo->SendBufferDrops = rtcInfo.sendBufferDrops;
+			managedInfo->StunResponses = rtcInfo.stunResponses;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Enumerates and monitors network interfaces once for the process. Peer connections
+		/// created afterwards share the result instead of each running their own scan.
+		/// </summary>
+		static void StartNetworkEnumerator()
+		{
+			Spitfire::NetworkEnumerator::Instance().Start();
+		}
+
+		static void StopNetworkEnumerator()
+		{
+			Spitfire::NetworkEnumerator::Instance().Stop();
+		}
+
+		/// <summary>
+		/// Restricts the adapters the shared enumerator hands out. Entries match case-insensitively
+		/// anywhere in an adapter's name or description, e.g. "vEthernet" or "docker" on the denylist.
+		/// An empty or null allowlist allows every adapter.
+		/// </summary>
+		static void SetInterfaceFilter(array<String^>^ allow, array<String^>^ deny, bool ignoreVpn)
+		{
+			std::vector<std::string> nativeAllow, nativeDeny;
+			if(allow != nullptr)
+			{
+				for each(auto entry in allow)
+					nativeAllow.push_back(marshal_as<std::string>(entry));
+			}
+			if(deny != nullptr)
+			{
+				for each(auto entry in deny)
+					nativeDeny.push_back(marshal_as<std::string>(entry));
+			}
+			Spitfire::NetworkEnumerator::Instance().SetInterfaceFilter(nativeAllow, nativeDeny, ignoreVpn);
+		}
+
+		static Spitfire::NetworkEnumeratorInfo^ GetNetworkEnumeratorInfo()
+		{
+			auto rtcInfo = Spitfire::NetworkEnumerator::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::NetworkEnumeratorInfo();
+			managedInfo->Networks = rtcInfo.networks;
+			managedInfo->Ignored = rtcInfo.ignored;
+			managedInfo->Subscribers = rtcInfo.subscribers;
+			managedInfo->Enumerations = rtcInfo.enumerations;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Leaves STUN and TURN servers out of new peer connections after they answered slower than
+		/// stallMs, or not at all, on two gathering rounds in a row. After retryMs one peer connection
+		/// tries them again. Zero stallMs turns pruning off.
+		/// </summary>
+		static void SetIceServerPruning(int stallMs, int retryMs)
+		{
+			Spitfire::IceServerHealth::Instance().SetPruning(stallMs, retryMs);
+		}
+
+		static Spitfire::IceServerHealthInfo^ GetIceServerHealthInfo()
+		{
+			auto rtcInfo = Spitfire::IceServerHealth::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::IceServerHealthInfo();
+			managedInfo->Servers = rtcInfo.servers;
+			managedInfo->Pruned = rtcInfo.pruned;
+			managedInfo->Skipped = rtcInfo.skipped;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Resolves STUN and TURN server names once for all peer connections created afterwards,
+		/// instead of a lookup per peer. Results are kept for their DNS TTL, failures briefly.
+		/// </summary>
+		static void StartDnsCache()
+		{
+			Spitfire::DnsCache::Instance().Start();
+		}
+
+		static void StopDnsCache()
+		{
+			Spitfire::DnsCache::Instance().Stop();
+		}
+
+		/// <summary>
+		/// Caps how long resolved names are kept, and sets how long failed lookups are. Clears the cache.
+		/// </summary>
+		static void SetDnsCacheTtl(int maxSeconds, int negativeSeconds)
+		{
+			Spitfire::DnsCache::Instance().SetTtl(maxSeconds, negativeSeconds);
+		}
+
+		static void ClearDnsCache()
+		{
+			Spitfire::DnsCache::Instance().Clear();
+		}
+
+		static Spitfire::DnsCacheInfo^ GetDnsCacheInfo()
+		{
+			auto rtcInfo = Spitfire::DnsCache::Instance().GetInfo();
+			auto managedInfo = gcnew Spitfire::DnsCacheInfo();
+			managedInfo->Entries = rtcInfo.entries;
+			managedInfo->Queries = rtcInfo.queries;
+			managedInfo->Lookups = rtcInfo.lookups;
+			managedInfo->Failures = rtcInfo.failures;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Creates a peer connection, call InitializeSSL before calling this.
+		/// </summary>
+		bool InitializePeerConnection()
+		{
+			if(ClaimPooledPeerConnection())
+				return true;
+			return conductor_->get()->InitializePeerConnection(min_port_, max_port_);
+		}
+
+		void CreateOffer()
+		{
+			conductor_->get()->CreateOffer();
+		}
+
+		/// <summary>
+		/// Run this within a loop to process signaling messages for your peer.
+		/// </summary>
+		bool ProcessMessages(Int32 delay)
+		{
+			return conductor_->get()->ProcessMessages(delay);
+		}
+
+		void SetOfferReply(String^ type, String^ sdp)
+		{
+			conductor_->get()->OnOfferReply(marshal_as<std::string>(type), marshal_as<std::string>(sdp));
+		}
+
+		/// <summary>
+		/// Provides an offer to your peer connection from a remote peer
+		/// This is used to setup the data channel between two peers. 
+		/// </summary>
+		void SetOfferRequest(String^ sdp)
+		{
+			if(!conductor_->get()->HasPeerConnection())
+				ClaimPooledPeerConnection();
+			conductor_->get()->OnOfferRequest(marshal_as<std::string>(sdp));
+		}
+
+		/// <summary>
+		/// Creates an offer and applies it as the local description. The task completes with the offer
+		/// once it is applied, independent of OnSuccessOffer, so many negotiations can be in flight at once.
+		/// </summary>
+		Task<SpitfireSdp^>^ CreateOfferAsync()
+		{
+			UInt64 id;
+			auto completion = BeginNegotiation(id);
+			conductor_->get()->CreateOfferAsync(id);
+			return completion->Task;
+		}
+
+		/// <summary>
+		/// Applies the remote peer's reply. The task completes once the remote description is set.
+		/// </summary>
+		Task^ SetOfferReplyAsync(String^ type, String^ sdp)
+		{
+			UInt64 id;
+			auto completion = BeginNegotiation(id);
+			conductor_->get()->OnOfferReplyAsync(id, marshal_as<std::string>(type), marshal_as<std::string>(sdp));
+			return completion->Task;
+		}
+
+		/// <summary>
+		/// Applies a remote offer and completes with the answer once it is set as the local description.
+		/// </summary>
+		Task<SpitfireSdp^>^ SetOfferRequestAsync(String^ sdp)
+		{
+			if(!conductor_->get()->HasPeerConnection())
+				ClaimPooledPeerConnection();
+
+			UInt64 id;
+			auto completion = BeginNegotiation(id);
+			conductor_->get()->OnOfferRequestAsync(id, marshal_as<std::string>(sdp));
+			return completion->Task;
+		}
+
+		/// <summary>
+		/// Applies a named ICE timing profile, trading dead peer detection time against keepalive traffic.
+		/// DatacenterLowLatency notices a dead peer within a few seconds, MobileBattery and
+		/// MassiveIdleFanIn ping far less and take tens of seconds. Set it before the peer connection
+		/// exists, afterwards libwebrtc refuses most of the change and false is returned.
+		/// </summary>
+		bool SetIceProfile(IceProfile profile)
+		{
+			return conductor_->get()->SetIceTiming(Spitfire::RtcIceTiming::ForProfile(static_cast<Spitfire::RtcIceProfile>(profile)));
+		}
+
+		/// <summary>
+		/// Sets individual ICE check intervals and timeouts, unset fields keep libwebrtc's defaults.
+		/// Returns false when the peer connection already exists and libwebrtc refuses the change.
+		/// </summary>
+		bool SetIceTiming(IceTiming^ timing)
+		{
+			Spitfire::RtcIceTiming native;
+			if(timing->CheckIntervalStrong.HasValue)
+				native.checkIntervalStrong = timing->CheckIntervalStrong.Value;
+			if(timing->CheckIntervalWeak.HasValue)
+				native.checkIntervalWeak = timing->CheckIntervalWeak.Value;
+			if(timing->CheckMinInterval.HasValue)
+				native.checkMinInterval = timing->CheckMinInterval.Value;
+			if(timing->UnwritableTimeout.HasValue)
+				native.unwritableTimeout = timing->UnwritableTimeout.Value;
+			if(timing->UnwritableMinChecks.HasValue)
+				native.unwritableMinChecks = timing->UnwritableMinChecks.Value;
+			if(timing->InactiveTimeout.HasValue)
+				native.inactiveTimeout = timing->InactiveTimeout.Value;
+			if(timing->StunKeepaliveInterval.HasValue)
+				native.stunKeepaliveInterval = timing->StunKeepaliveInterval.Value;
+			if(timing->ReceivingTimeout.HasValue)
+				native.receivingTimeout = timing->ReceivingTimeout.Value;
+			return conductor_->get()->SetIceTiming(native);
+		}
+
+		/// <summary>
+		/// Raises OnIceGatheringStateChange with Complete once the first server reflexive candidate
+		/// is in, DeadlineMs after gathering started, or once a candidate shows no NAT is in the way,
+		/// whichever of the enabled ones comes first. Later candidates are still raised.
+		/// </summary>
+		void SetGatheringPolicy(GatheringPolicy^ policy)
+		{
+			Spitfire::RtcGatheringPolicy native;
+			native.firstServerReflexive = policy->FirstServerReflexive;
+			native.deadlineMs = policy->DeadlineMs;
+			native.relayNotNeeded = policy->RelayNotNeeded;
+			conductor_->get()->SetGatheringPolicy(native);
+		}
+
+		/// <summary>
+		/// Socket buffer sizes in bytes for this peer's own UDP sockets, 0 keeps the OS default.
+		/// Call before InitializePeerConnection.
+		/// </summary>
+		void SetSocketBufferSizes(int receiveBytes, int sendBytes)
+		{
+			Spitfire::RtcSocketBufferSizes buffers;
+			buffers.receive = receiveBytes;
+			buffers.send = sendBytes;
+			conductor_->get()->SetSocketBufferSizes(buffers);
+		}
+
+		/// <summary>
+		/// Raises OnPeerLost at most boundMs after the last packet from the remote peer, 0 turns it off.
+		/// Tightens the ICE check interval and unwritable and receiving timeouts of this peer connection
+		/// to fit the bound, on top of SetIceProfile or SetIceTiming. A bound must be set before the peer
+		/// connection exists, false is returned otherwise.
+		/// </summary>
+		bool SetPeerLostTimeout(int boundMs)
+		{
+			return conductor_->get()->SetPeerLostTimeout(boundMs);
+		}
+
+		/// <summary>
+		/// Selects the candidate pair by smoothed RTT, jitter and loss measured by the connectivity checks
+		/// instead of candidate priority and adapter type, switching only when another pair is clearly
+		/// better for a few seconds. Takes effect on the controlling side. Enable before InitializePeerConnection.
+		/// </summary>
+		void EnableMeasuredIceSelection(bool enabled)
+		{
+			conductor_->get()->SetMeasuredIceSelection(enabled);
+		}
+
+		/// <summary>
+		/// Returns the selected candidate pair, its measurements and the reason it was chosen.
+		/// </summary>
+		Spitfire::IceSelectionInfo^ GetIceSelectionInfo()
+		{
+			auto rtcInfo = conductor_->get()->GetIceSelectionInfo();
+			auto managedInfo = gcnew Spitfire::IceSelectionInfo();
+			managedInfo->Local = gcnew String(rtcInfo.local.c_str());
+			managedInfo->Remote = gcnew String(rtcInfo.remote.c_str());
+			managedInfo->RttMs = rtcInfo.rttMs;
+			managedInfo->JitterMs = rtcInfo.jitterMs;
+			managedInfo->Loss = rtcInfo.loss;
+			managedInfo->Reason = gcnew String(rtcInfo.reason.c_str());
+			managedInfo->Switches = rtcInfo.switches;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// ICE-lite style server mode for hosts with public addresses. Only host candidates are gathered,
+		/// STUN/TURN servers are ignored and our own checks drop to a sparse keepalive while the
+		/// controlling remote drives them. The agent itself stays full ICE, so the SDP is not marked
+		/// a=ice-lite. Enable before InitializePeerConnection, offers fail in this mode.
+		/// </summary>
+		void EnableIceLite(bool enabled)
+		{
+			conductor_->get()->SetIceLite(enabled);
+		}
+
+		/// <summary>
+		/// Sends data channel only descriptions as a compact binary blob (ICE credentials, DTLS
+		/// fingerprint, SCTP parameters and candidates) through OnSuccessCompactOffer/Answer.
+		/// </summary>
+		void EnableCompactSignaling(bool enabled)
+		{
+			conductor_->get()->SetCompactSignaling(enabled);
+		}
+
+		bool SetOfferReplyCompact(array<Byte>^ data)
+		{
+			auto bytes = ToNativeBytes(data);
+			return conductor_->get()->OnOfferReplyCompact(bytes.data(), bytes.size());
+		}
+
+		bool SetOfferRequestCompact(array<Byte>^ data)
+		{
+			if(!conductor_->get()->HasPeerConnection())
+				ClaimPooledPeerConnection();
+
+			auto bytes = ToNativeBytes(data);
+			return conductor_->get()->OnOfferRequestCompact(bytes.data(), bytes.size());
+		}
+
+		/// <summary>
+		/// The local description in compact form with every candidate gathered so far, or null.
+		/// </summary>
+		array<Byte>^ GetLocalCompactDescription()
+		{
+			std::string bytes;
+			if(!conductor_->get()->GetLocalCompactDescription(&bytes))
+				return nullptr;
+
+			array<Byte>^ data_array = gcnew array<Byte>(static_cast<int>(bytes.size()));
+			Marshal::Copy(IntPtr(const_cast<char*>(bytes.data())), data_array, 0, data_array->Length);
+			return data_array;
+		}
+
+		/// <summary>
+		/// Expands a compact description to SDP, for signaling servers that bridge to regular peers.
+		/// Returns null if the data is not a valid compact description.
+		/// </summary>
+		static SpitfireSdp^ ExpandCompactSdp(array<Byte>^ data)
+		{
+			auto bytes = ToNativeBytes(data);
+			Spitfire::RtcCompactDescription compact;
+			if(!Spitfire::CompactSdp::Deserialize(bytes.data(), bytes.size(), &compact))
+				return nullptr;
+
+			auto sdpModel = gcnew SpitfireSdp();
+			sdpModel->Type = compact.type == "offer" ? SdpTypes::Offer : SdpTypes::Answer;
+			sdpModel->Sdp = gcnew String(Spitfire::CompactSdp::ToSdp(compact).c_str());
+			return sdpModel;
+		}
+
+		/// <summary>
+		/// Compacts a data channel only SDP. Returns null if it carries anything else.
+		/// </summary>
+		static array<Byte>^ CompressSdp(SpitfireSdp^ sdp)
+		{
+			webrtc::SdpParseError error;
+			std::unique_ptr<webrtc::SessionDescriptionInterface> desc(webrtc::CreateSessionDescription(
+				sdp->Type == SdpTypes::Offer ? "offer" : "answer", marshal_as<std::string>(sdp->Sdp), &error));
+
+			Spitfire::RtcCompactDescription compact;
+			std::string bytes;
+			if(!Spitfire::CompactSdp::FromDescription(desc.get(), &compact) || !Spitfire::CompactSdp::Serialize(compact, &bytes))
+				return nullptr;
+
+			array<Byte>^ data_array = gcnew array<Byte>(static_cast<int>(bytes.size()));
+			Marshal::Copy(IntPtr(const_cast<char*>(bytes.data())), data_array, 0, data_array->Length);
+			return data_array;
+		}
+
+		bool AddIceCandidate(String^ sdp_mid, Int32 sdp_mlineindex, String^ sdp)
+		{
+			return conductor_->get()->AddIceCandidate(marshal_as<std::string>(sdp_mid), sdp_mlineindex, marshal_as<std::string>(sdp));
+		}
+
+		/// <summary>
+		/// Collects local candidates and raises OnIceCandidates once windowMs has passed since the
+		/// first one or gathering completes, whichever is first. A zero window waits for completion.
+		/// </summary>
+		void EnableIceCandidateBatching(bool enabled, int windowMs)
+		{
+			conductor_->get()->SetIceCandidateBatching(enabled, windowMs);
+		}
+
+		/// <summary>
+		/// Applies a batch of remote candidates in a single hop to the signaling thread.
+		/// Returns the number of candidates that were applied.
+		/// </summary>
+		int AddIceCandidates(array<SpitfireIceCandidate^>^ candidates)
+		{
+			std::vector<Spitfire::RtcIceCandidate> batch;
+			batch.reserve(candidates->Length);
+			for each(auto candidate in candidates)
+			{
+				batch.push_back(Spitfire::RtcIceCandidate{ marshal_as<std::string>(candidate->SdpMid), candidate->SdpIndex, marshal_as<std::string>(candidate->Sdp) });
+			}
+			return conductor_->get()->AddIceCandidates(batch);
+		}
+
+		void AddServerConfig(ServerConfig^ config)
+		{
+			std::string hostUri, username, password;
+			ToNativeServerConfig(config, hostUri, username, password);
+			conductor_->get()->AddServerConfig(hostUri, username, password);
+		}
+		/// <summary>
+		/// Creates a data channel from within the application.
+		/// Only call if your application is setting up the connection and preparing to offer.
+		/// </summary>
+		void CreateDataChannel(DataChannelOptions^ dataChannelOptions)
+		{
+			conductor_->get()->CreateDataChannel(marshal_as<std::string>(dataChannelOptions->Label), ToNativeOptions(dataChannelOptions));
+		}
+
+		/// <summary>
+		/// Declares a channel that both peers create at connection setup with Negotiated forced on,
+		/// so it opens as soon as SCTP does without the in-band open handshake. Both sides must
+		/// declare the same templates; when Id is -1 ids are assigned in declaration order.
+		/// </summary>
+		void AddChannelTemplate(DataChannelOptions^ dataChannelOptions)
+		{
+			conductor_->get()->AddChannelTemplate(marshal_as<std::string>(dataChannelOptions->Label), ToNativeOptions(dataChannelOptions));
+		}
+
+		void ClearChannelTemplates()
+		{
+			conductor_->get()->ClearChannelTemplates();
+		}
+		/// <summary>
+		/// Send your text through the data channel
+		/// </summary>
+		void DataChannelSendText(String^ label, String^ text)
 		{
 			conductor_->get()->DataChannelSendText(marshal_as<std::string>(label), marshal_as<std::string>(text));
 		}
@@ -704,6 +1811,159 @@ namespace Spitfire
 			conductor_->get()->DataChannelSendData(marshal_as<std::string>(label), webrtc::DataBuffer(writeBuffer, true));
 		}
 
+		/// <summary>
+		/// Limits how many received bytes the application may have outstanding on a data channel.
+		/// In callback mode delivered messages count against the window until acknowledged with AcknowledgeDataMessages,
+		/// in batched mode messages wait natively until DrainDataMessages is called. A window of zero is unlimited.
+		/// The window does not slow the remote sender, a channel holding more than 64 MB natively is closed.
+		/// </summary>
+		void SetDataChannelReceiveWindow(String^ label, DataChannelReceiveMode mode, int windowBytes)
+		{
+			if (windowBytes < 0)
+				throw gcnew ArgumentOutOfRangeException("windowBytes");
+
+			conductor_->get()->SetDataChannelReceiveWindow(marshal_as<std::string>(label), static_cast<Spitfire::RtcReceiveMode>(mode), static_cast<uint64_t>(windowBytes));
+		}
+
+		/// <summary>
+		/// Tells the data channel the application is done with the given amount of delivered bytes.
+		/// </summary>
+		void AcknowledgeDataMessages(String^ label, int bytes)
+		{
+			if (bytes < 0)
+				throw gcnew ArgumentOutOfRangeException("bytes");
+
+			conductor_->get()->AcknowledgeDataMessages(marshal_as<std::string>(label), static_cast<uint64_t>(bytes));
+		}
+
+		/// <summary>
+		/// Returns up to maxMessages messages held by a data channel in batched mode.
+		/// </summary>
+		array<Spitfire::DataMessage^>^ DrainDataMessages(String^ label, int maxMessages)
+		{
+			if (maxMessages < 0)
+				throw gcnew ArgumentOutOfRangeException("maxMessages");
+
+			std::vector<webrtc::DataBuffer> buffers;
+			conductor_->get()->DrainDataMessages(marshal_as<std::string>(label), buffers, static_cast<size_t>(maxMessages));
+			auto messages = gcnew array<Spitfire::DataMessage^>(static_cast<int>(buffers.size()));
+			for(int i = 0; i < messages->Length; i++)
+			{
+				messages[i] = ToDataMessage(buffers[i]);
+			}
+			return messages;
+		}
+
+		/// <summary>
+		/// Forwards every message received on the data channel to a data channel on another peer.
+		/// Messages are relayed natively and never copied into managed memory.
+		/// </summary>
+		void AddDataChannelRoute(String^ label, SpitfireRtc^ destination, String^ destinationLabel)
+		{
+			conductor_->get()->AddDataChannelRoute(marshal_as<std::string>(label), destination->conductor_->get(), marshal_as<std::string>(destinationLabel));
+		}
+
+		/// <summary>
+		/// Stops forwarding messages from the data channel to the destination's data channel.
+		/// </summary>
+		void RemoveDataChannelRoute(String^ label, SpitfireRtc^ destination, String^ destinationLabel)
+		{
+			conductor_->get()->RemoveDataChannelRoute(marshal_as<std::string>(label), destination->conductor_->get(), marshal_as<std::string>(destinationLabel));
+		}
+
+		/// <summary>
+		/// When set, relayed messages are no longer raised through OnDataMessage.
+		/// Stays set while routes are removed and added, it only takes effect while the channel has a route.
+		/// </summary>
+		void SetDataChannelForwardOnly(String^ label, bool forwardOnly)
+		{
+			conductor_->get()->SetDataChannelForwardOnly(marshal_as<std::string>(label), forwardOnly);
+		}
+
+		/// <summary>
+		/// Returns a snapshot of the counters of a route between two data channels.
+		/// </summary>
+		Spitfire::DataChannelRouteInfo^ GetDataChannelRouteInfo(String^ label, SpitfireRtc^ destination, String^ destinationLabel)
+		{
+			auto rtcInfo = conductor_->get()->GetDataChannelRouteInfo(marshal_as<std::string>(label), destination->conductor_->get(), marshal_as<std::string>(destinationLabel));
+			auto managedInfo = gcnew Spitfire::DataChannelRouteInfo();
+			managedInfo->MessagesForwarded = rtcInfo.messagesForwarded;
+			managedInfo->BytesForwarded = rtcInfo.bytesForwarded;
+			managedInfo->MessagesDropped = rtcInfo.messagesDropped;
+			return managedInfo;
+		}
+
+		/// <summary>
+		/// Subscribes the data channel to a topic, every message published to it will be sent on the channel.
+		/// </summary>
+		void SubscribeTopic(String^ label, String^ topic, TopicBackpressure backpressure, int maxQueuedBytes)
+		{
+			if (maxQueuedBytes < 0)
+				throw gcnew ArgumentOutOfRangeException("maxQueuedBytes");
+
+			conductor_->get()->SubscribeTopic(marshal_as<std::string>(label), marshal_as<std::string>(topic), static_cast<Spitfire::RtcTopicBackpressure>(backpressure), static_cast<uint64_t>(maxQueuedBytes));
+		}
+
+		void UnsubscribeTopic(String^ label, String^ topic)
+		{
+			conductor_->get()->UnsubscribeTopic(marshal_as<std::string>(label), marshal_as<std::string>(topic));
+		}
+
+		/// <summary>
+		/// Publishes every message received on the data channel to a topic natively.
+		/// When forwardOnly is set the messages are no longer raised through OnDataMessage.
+		/// </summary>
+		void PublishDataChannel(String^ label, String^ topic, bool forwardOnly)
+		{
+			conductor_->get()->PublishDataChannel(marshal_as<std::string>(label), marshal_as<std::string>(topic), forwardOnly);
+		}
+
+		void UnpublishDataChannel(String^ label)
+		{
+			conductor_->get()->UnpublishDataChannel(marshal_as<std::string>(label));
+		}
+
+		/// <summary>
+		/// Sends binary data to every subscriber of a topic, returns how many subscribers it was handed to.
+		/// </summary>
+		static int PublishTopic(String^ topic, Byte* array_data, int length)
+		{
+			rtc::CopyOnWriteBuffer writeBuffer(array_data, length);
+			return static_cast<int>(Spitfire::TopicRegistry::Instance().Publish(marshal_as<std::string>(topic), webrtc::DataBuffer(writeBuffer, true)));
+		}
+
+		/// <summary>
+		/// Sends text to every subscriber of a topic, returns how many subscribers it was handed to.
+		/// </summary>
+		static int PublishTopicText(String^ topic, String^ text)
+		{
+			return static_cast<int>(Spitfire::TopicRegistry::Instance().Publish(marshal_as<std::string>(topic), webrtc::DataBuffer(marshal_as<std::string>(text))));
+		}
+
+		/// <summary>
+		/// Limits how many messages per second a topic accepts, messages over the limit are discarded.
+		/// Pass zero to remove the limit.
+		/// </summary>
+		static void SetTopicRateLimit(String^ topic, double messagesPerSecond, int burst)
+		{
+			Spitfire::TopicRegistry::Instance().SetRateLimit(marshal_as<std::string>(topic), messagesPerSecond, static_cast<uint32_t>(burst));
+		}
+
+		/// <summary>
+		/// Returns a snapshot of the counters of a topic.
+		/// </summary>
+		static Spitfire::TopicInfo^ GetTopicInfo(String^ topic)
+		{
+			auto rtcInfo = Spitfire::TopicRegistry::Instance().GetTopicInfo(marshal_as<std::string>(topic));
+			auto managedInfo = gcnew Spitfire::TopicInfo();
+			managedInfo->Subscribers = rtcInfo.subscribers;
+			managedInfo->MessagesPublished = rtcInfo.messagesPublished;
+			managedInfo->MessagesDelivered = rtcInfo.messagesDelivered;
+			managedInfo->MessagesDropped = rtcInfo.messagesDropped;
+			managedInfo->MessagesRateLimited = rtcInfo.messagesRateLimited;
+			return managedInfo;
+		}
+
 	protected:
 		!SpitfireRtc()
 		{
@@ -0,0 +1,84 @@
+#include "StunResponder.h"
+
+#include "api/transport/stun.h"
+#include "rtc_base/async_udp_socket.h"
+#include "rtc_base/logging.h"
+
+namespace Spitfire
+{
+	StunResponder& StunResponder::Instance()
+	{
+		static StunResponder* const responder = new StunResponder();
+		return *responder;
+	}
+
+	bool StunResponder::Start(uint16_t port)
+	{
+		rtc::CritScope lock(&crit_);
+		if (thread_)
+			return port_ == port;
+
+		auto thread = rtc::Thread::CreateWithSocketServer();
+		thread->SetName("spitfire_stun", nullptr);
+		thread->Start();
+
+		const bool started = thread->Invoke<bool>(RTC_FROM_HERE, [this, &thread, port]()
+		{
+			rtc::AsyncUDPSocket* socket = rtc::AsyncUDPSocket::Create(thread->socketserver(), rtc::SocketAddress(rtc::IPAddress(INADDR_ANY), port));
+			if (!socket)
+				return false;
+			server_.reset(new cricket::StunServer(socket));
+			return true;
+		});
+		if (!started)
+		{
+			RTC_LOG(WARNING) << "Could not bind the STUN server to port " << port;
+			thread->Stop();
+			return false;
+		}
+		thread_ = std::move(thread);
+		port_ = port;
+		return true;
+	}
+
+	void StunResponder::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+		}
+		if (!thread)
+			return;
+
+		thread->Invoke<void>(RTC_FROM_HERE, [this]()
+		{
+			server_.reset();
+		});
+		thread->Stop();
+	}
+
+	bool StunResponder::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return thread_ != nullptr;
+	}
+
+	bool StunResponder::Answer(const char* data, size_t size, const rtc::SocketAddress& remote, rtc::ByteBufferWriter* response)
+	{
+		cricket::StunMessage request;
+		rtc::ByteBufferReader reader(data, size);
+		if (!request.Read(&reader) || request.type() != cricket::STUN_BINDING_REQUEST || request.GetByteString(cricket::STUN_ATTR_USERNAME))
+			return false;
+
+		// Same answer as cricket::StunServer, RFC 3489 clients get a plain MAPPED-ADDRESS.
+		cricket::StunMessage message;
+		message.SetType(cricket::STUN_BINDING_RESPONSE);
+		message.SetTransactionID(request.transaction_id());
+		if (request.IsLegacy())
+			message.AddAttribute(std::make_unique<cricket::StunAddressAttribute>(cricket::STUN_ATTR_MAPPED_ADDRESS, remote));
+		else
+			message.AddAttribute(std::make_unique<cricket::StunXorAddressAttribute>(cricket::STUN_ATTR_XOR_MAPPED_ADDRESS, remote));
+		return message.Write(response);
+	}
+}
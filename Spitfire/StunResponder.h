@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+
+#include "p2p/base/stun_server.h"
+#include "rtc_base/byte_buffer.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+
+namespace Spitfire
+{
+	// Lets clients, and our own peers, discover server reflexive addresses without an
+	// external STUN server. Either runs the vendored cricket::StunServer on a port of its
+	// own, or answers from the UDP mux's shared sockets through Answer.
+	class StunResponder
+	{
+	public:
+		static StunResponder& Instance();
+
+		bool Start(uint16_t port);
+		void Stop();
+		bool IsRunning() const;
+
+		// Writes the binding response to a plain binding request. Requests carrying USERNAME
+		// are ICE checks for a peer connection and are left alone.
+		static bool Answer(const char* data, size_t size, const rtc::SocketAddress& remote, rtc::ByteBufferWriter* response);
+
+	private:
+		StunResponder() = default;
+
+		mutable rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		uint16_t port_ = 0;
+		// Only touched on |thread_|.
+		std::unique_ptr<cricket::StunServer> server_;
+	};
+}
@@ -0,0 +1,326 @@
+#include "TopicRegistry.h"
+#include "RtcConductor.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	TopicRegistry& TopicRegistry::Instance()
+	{
+		static TopicRegistry* const registry = new TopicRegistry();
+		return *registry;
+	}
+
+	void TopicRegistry::Subscribe(RtcConductor* conductor, const std::string& label, const std::string& topic, RtcTopicBackpressure policy, uint64_t max_queued_bytes)
+	{
+		RTC_DCHECK(conductor);
+		rtc::CritScope lock(&crit_);
+
+		auto& entry = topics_[topic];
+		for (auto const& subscriber : entry.subscribers)
+		{
+			if (subscriber->conductor == conductor && subscriber->label == label)
+				return;
+		}
+
+		auto subscriber = std::make_shared<Subscriber>();
+		subscriber->conductor = conductor;
+		subscriber->label = label;
+		subscriber->thread = conductor->SignalingThread();
+		subscriber->channel = conductor->GetDataChannel(label);
+		subscriber->policy = policy;
+		subscriber->maxQueuedBytes = max_queued_bytes;
+		subscriber->counters = entry.counters;
+		entry.subscribers.push_back(subscriber);
+		channels_[ChannelKey(conductor, label)].push_back(subscriber);
+		bindingCount_++;
+	}
+
+	void TopicRegistry::RemoveFromChannel(const std::shared_ptr<Subscriber>& subscriber)
+	{
+		auto it = channels_.find(ChannelKey(subscriber->conductor, subscriber->label));
+		if (it == channels_.end())
+			return;
+
+		auto& subscribers = it->second;
+		subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscriber), subscribers.end());
+		if (subscribers.empty())
+			channels_.erase(it);
+	}
+
+	void TopicRegistry::Unsubscribe(RtcConductor* conductor, const std::string& label, const std::string& topic)
+	{
+		rtc::CritScope lock(&crit_);
+
+		auto it = topics_.find(topic);
+		if (it == topics_.end())
+			return;
+
+		auto& subscribers = it->second.subscribers;
+		for (auto subscriber = subscribers.begin(); subscriber != subscribers.end(); ++subscriber)
+		{
+			if ((*subscriber)->conductor == conductor && (*subscriber)->label == label)
+			{
+				RemoveFromChannel(*subscriber);
+				subscribers.erase(subscriber);
+				bindingCount_--;
+				break;
+			}
+		}
+	}
+
+	void TopicRegistry::BindPublisher(RtcConductor* conductor, const std::string& label, const std::string& topic, bool forward_only)
+	{
+		rtc::CritScope lock(&crit_);
+
+		const ChannelKey key(conductor, label);
+		if (publishers_.find(key) == publishers_.end())
+			bindingCount_++;
+
+		publishers_[key] = Publisher{ topic, forward_only };
+	}
+
+	void TopicRegistry::UnbindPublisher(RtcConductor* conductor, const std::string& label)
+	{
+		rtc::CritScope lock(&crit_);
+
+		if (publishers_.erase(ChannelKey(conductor, label)) > 0)
+			bindingCount_--;
+	}
+
+	void TopicRegistry::SetRateLimit(const std::string& topic, double messages_per_second, uint32_t burst)
+	{
+		rtc::CritScope lock(&crit_);
+
+		auto& entry = topics_[topic];
+		entry.rate = std::max(0.0, messages_per_second);
+		entry.burst = std::max(1.0, static_cast<double>(burst));
+		entry.tokens = entry.burst;
+		entry.lastRefillMs = rtc::TimeMillis();
+	}
+
+	bool TopicRegistry::TakeToken(Topic& topic)
+	{
+		if (topic.rate <= 0)
+			return true;
+
+		const int64_t now = rtc::TimeMillis();
+		topic.tokens = std::min(topic.burst, topic.tokens + (now - topic.lastRefillMs) * topic.rate / 1000.0);
+		topic.lastRefillMs = now;
+		if (topic.tokens < 1.0)
+			return false;
+
+		topic.tokens -= 1.0;
+		return true;
+	}
+
+	uint32_t TopicRegistry::Publish(const std::string& topic, const webrtc::DataBuffer& buffer)
+	{
+		struct Target
+		{
+			std::shared_ptr<Subscriber> subscriber;
+			rtc::Thread* thread;
+			rtc::scoped_refptr<webrtc::DataChannelInterface> channel;
+		};
+
+		// Snapshot under the lock, post without it so a large fan out does not stall other channels.
+		std::vector<Target> targets;
+		{
+			rtc::CritScope lock(&crit_);
+
+			auto it = topics_.find(topic);
+			if (it == topics_.end())
+				return 0;
+
+			auto& entry = it->second;
+			if (!TakeToken(entry))
+			{
+				entry.rateLimited++;
+				return 0;
+			}
+			entry.published++;
+
+			targets.reserve(entry.subscribers.size());
+			for (auto const& subscriber : entry.subscribers)
+			{
+				if (!subscriber->thread || !subscriber->channel)
+				{
+					subscriber->counters->dropped++;
+					continue;
+				}
+				targets.push_back(Target{ subscriber, subscriber->thread, subscriber->channel });
+			}
+		}
+
+		for (auto const& target : targets)
+		{
+			std::shared_ptr<Subscriber> subscriber = target.subscriber;
+			rtc::scoped_refptr<webrtc::DataChannelInterface> channel = target.channel;
+			target.thread->PostTask(RTC_FROM_HERE, [subscriber, channel, buffer]()
+			{
+				Deliver(subscriber, channel, buffer);
+			});
+		}
+		return static_cast<uint32_t>(targets.size());
+	}
+
+	void TopicRegistry::Deliver(const std::shared_ptr<Subscriber>& subscriber, rtc::scoped_refptr<webrtc::DataChannelInterface> channel, const webrtc::DataBuffer& buffer)
+	{
+		if (channel->state() != webrtc::DataChannelInterface::kOpen)
+		{
+			subscriber->counters->dropped++;
+			return;
+		}
+
+		// Anything already queued must go out first to keep ordering.
+		const bool slow = !subscriber->queue.empty() || channel->buffered_amount() > kSubscriberHighWater;
+		if (!slow)
+		{
+			if (channel->Send(buffer))
+				subscriber->counters->delivered++;
+			else
+				subscriber->counters->dropped++;
+			return;
+		}
+
+		if (subscriber->policy == RtcTopicBackpressure::Queue &&
+			subscriber->queuedBytes + buffer.size() <= subscriber->maxQueuedBytes)
+		{
+			subscriber->queuedBytes += buffer.size();
+			subscriber->queue.push_back(buffer);
+			return;
+		}
+		subscriber->counters->dropped++;
+	}
+
+	void TopicRegistry::Drain(const std::shared_ptr<Subscriber>& subscriber, rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
+	{
+		while (!subscriber->queue.empty() && channel->buffered_amount() <= kSubscriberHighWater)
+		{
+			const auto& buffer = subscriber->queue.front();
+			subscriber->queuedBytes -= buffer.size();
+			if (channel->Send(buffer))
+				subscriber->counters->delivered++;
+			else
+				subscriber->counters->dropped++;
+			subscriber->queue.pop_front();
+		}
+	}
+
+	RtcTopicInfo TopicRegistry::GetTopicInfo(const std::string& topic)
+	{
+		auto info = RtcTopicInfo();
+		rtc::CritScope lock(&crit_);
+
+		auto it = topics_.find(topic);
+		if (it != topics_.end())
+		{
+			info.subscribers = static_cast<uint32_t>(it->second.subscribers.size());
+			info.messagesPublished = it->second.published;
+			info.messagesDelivered = it->second.counters->delivered;
+			info.messagesDropped = it->second.counters->dropped;
+			info.messagesRateLimited = it->second.rateLimited;
+		}
+		return info;
+	}
+
+	void TopicRegistry::OnDataChannel(RtcConductor* conductor, const std::string& label, rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
+	{
+		if (bindingCount_ == 0)
+			return;
+
+		rtc::CritScope lock(&crit_);
+		auto it = channels_.find(ChannelKey(conductor, label));
+		if (it == channels_.end())
+			return;
+
+		for (auto const& subscriber : it->second)
+		{
+			subscriber->thread = conductor->SignalingThread();
+			subscriber->channel = channel;
+		}
+	}
+
+	bool TopicRegistry::OnMessage(RtcConductor* conductor, const std::string& label, const webrtc::DataBuffer& buffer)
+	{
+		if (bindingCount_ == 0)
+			return false;
+
+		Publisher publisher;
+		{
+			rtc::CritScope lock(&crit_);
+			auto it = publishers_.find(ChannelKey(conductor, label));
+			if (it == publishers_.end())
+				return false;
+			publisher = it->second;
+		}
+		Publish(publisher.topic, buffer);
+		return publisher.forwardOnly;
+	}
+
+	void TopicRegistry::OnBufferedAmountChange(RtcConductor* conductor, const std::string& label)
+	{
+		if (bindingCount_ == 0)
+			return;
+
+		std::vector<std::pair<std::shared_ptr<Subscriber>, rtc::scoped_refptr<webrtc::DataChannelInterface>>> pending;
+		{
+			rtc::CritScope lock(&crit_);
+			auto it = channels_.find(ChannelKey(conductor, label));
+			if (it == channels_.end())
+				return;
+
+			for (auto const& subscriber : it->second)
+			{
+				if (subscriber->channel)
+					pending.emplace_back(subscriber, subscriber->channel);
+			}
+		}
+
+		// Called on the conductor's signaling thread, which owns the queues.
+		for (auto const& entry : pending)
+		{
+			Drain(entry.first, entry.second);
+		}
+	}
+
+	void TopicRegistry::RemoveConductor(RtcConductor* conductor)
+	{
+		if (bindingCount_ == 0)
+			return;
+
+		rtc::CritScope lock(&crit_);
+		for (auto& topic : topics_)
+		{
+			auto& subscribers = topic.second.subscribers;
+			auto removed = std::remove_if(subscribers.begin(), subscribers.end(), [conductor](const std::shared_ptr<Subscriber>& subscriber)
+			{
+				return subscriber->conductor == conductor;
+			});
+			bindingCount_ -= static_cast<int>(std::distance(removed, subscribers.end()));
+			subscribers.erase(removed, subscribers.end());
+		}
+
+		for (auto it = channels_.begin(); it != channels_.end();)
+		{
+			if (it->first.first == conductor)
+				it = channels_.erase(it);
+			else
+				++it;
+		}
+
+		for (auto it = publishers_.begin(); it != publishers_.end();)
+		{
+			if (it->first.first == conductor)
+			{
+				it = publishers_.erase(it);
+				bindingCount_--;
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
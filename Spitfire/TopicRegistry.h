@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "api/data_channel_interface.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+
+namespace Spitfire
+{
+	class RtcConductor;
+
+	enum class RtcTopicBackpressure
+	{
+		// Messages for a subscriber that cannot keep up are discarded.
+		Drop,
+		// Messages are held natively until the subscriber's send buffer drains.
+		Queue
+	};
+
+	struct RtcTopicInfo
+	{
+		uint32_t subscribers;
+		uint64_t messagesPublished;
+		uint64_t messagesDelivered;
+		uint64_t messagesDropped;
+		uint64_t messagesRateLimited;
+	};
+
+	// Process wide publish/subscribe fabric for data channels. A publish fans out
+	// to every subscribed channel sharing one CopyOnWriteBuffer, each send runs
+	// on the subscriber's own signaling thread.
+	class TopicRegistry
+	{
+	public:
+		// A subscriber whose channel has more than this buffered is treated as slow.
+		static const uint64_t kSubscriberHighWater = 1024 * 1024;
+
+		static TopicRegistry& Instance();
+
+		void Subscribe(RtcConductor* conductor, const std::string& label, const std::string& topic, RtcTopicBackpressure policy, uint64_t max_queued_bytes);
+		void Unsubscribe(RtcConductor* conductor, const std::string& label, const std::string& topic);
+
+		// Messages received on (conductor, label) are published to |topic|.
+		void BindPublisher(RtcConductor* conductor, const std::string& label, const std::string& topic, bool forward_only);
+		void UnbindPublisher(RtcConductor* conductor, const std::string& label);
+
+		// Limits |topic| to |messages_per_second| with bursts of up to |burst| messages, zero disables the limit.
+		void SetRateLimit(const std::string& topic, double messages_per_second, uint32_t burst);
+
+		// Returns the number of subscribers the message was handed to.
+		uint32_t Publish(const std::string& topic, const webrtc::DataBuffer& buffer);
+		RtcTopicInfo GetTopicInfo(const std::string& topic);
+
+		// Hooks called by the conductor and its observers.
+		void OnDataChannel(RtcConductor* conductor, const std::string& label, rtc::scoped_refptr<webrtc::DataChannelInterface> channel);
+		bool OnMessage(RtcConductor* conductor, const std::string& label, const webrtc::DataBuffer& buffer);
+		void OnBufferedAmountChange(RtcConductor* conductor, const std::string& label);
+		void RemoveConductor(RtcConductor* conductor);
+
+	private:
+		struct Counters
+		{
+			std::atomic<uint64_t> delivered{ 0 };
+			std::atomic<uint64_t> dropped{ 0 };
+		};
+
+		struct Subscriber
+		{
+			RtcConductor* conductor;
+			std::string label;
+			rtc::Thread* thread;
+			rtc::scoped_refptr<webrtc::DataChannelInterface> channel;
+			RtcTopicBackpressure policy;
+			uint64_t maxQueuedBytes;
+			std::shared_ptr<Counters> counters;
+
+			// Only touched on |thread|.
+			std::deque<webrtc::DataBuffer> queue;
+			uint64_t queuedBytes = 0;
+		};
+
+		struct Topic
+		{
+			std::vector<std::shared_ptr<Subscriber>> subscribers;
+
+			double rate = 0;
+			double burst = 0;
+			double tokens = 0;
+			int64_t lastRefillMs = 0;
+
+			std::shared_ptr<Counters> counters = std::make_shared<Counters>();
+			uint64_t published = 0;
+			uint64_t rateLimited = 0;
+		};
+
+		struct Publisher
+		{
+			std::string topic;
+			bool forwardOnly;
+		};
+
+		typedef std::pair<RtcConductor*, std::string> ChannelKey;
+
+		TopicRegistry() = default;
+
+		bool TakeToken(Topic& topic);
+		static void Deliver(const std::shared_ptr<Subscriber>& subscriber, rtc::scoped_refptr<webrtc::DataChannelInterface> channel, const webrtc::DataBuffer& buffer);
+		static void Drain(const std::shared_ptr<Subscriber>& subscriber, rtc::scoped_refptr<webrtc::DataChannelInterface> channel);
+
+		void RemoveFromChannel(const std::shared_ptr<Subscriber>& subscriber);
+
+		rtc::CriticalSection crit_;
+		std::unordered_map<std::string, Topic> topics_;
+		// Every subscription of a channel across all topics, so channel events touch only their own entries.
+		std::map<ChannelKey, std::vector<std::shared_ptr<Subscriber>>> channels_;
+		std::map<ChannelKey, Publisher> publishers_;
+		std::atomic<int> bindingCount_{ 0 };
+	};
+}
@@ -0,0 +1,338 @@
+#include "TurnRelay.h"
+
+#include <algorithm>
+
+#include "api/transport/stun.h"
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "rtc_base/async_udp_socket.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
+
+namespace Spitfire
+{
+	namespace
+	{
+		// Refills at |rate| bytes per second and holds at most one second worth.
+		class TokenBucket
+		{
+		public:
+			explicit TokenBucket(int rate) :
+				rate_(rate),
+				tokens_(rate),
+				lastMs_(rtc::TimeMillis())
+			{
+			}
+
+			bool Take(size_t bytes)
+			{
+				if (rate_ <= 0)
+					return true;
+
+				const int64_t now = rtc::TimeMillis();
+				tokens_ = std::min<int64_t>(rate_, tokens_ + (now - lastMs_) * rate_ / 1000);
+				lastMs_ = now;
+				if (tokens_ < static_cast<int64_t>(bytes))
+					return false;
+				tokens_ -= bytes;
+				return true;
+			}
+
+		private:
+			const int64_t rate_;
+			int64_t tokens_;
+			int64_t lastMs_;
+		};
+
+		// The external socket of one allocation, counts and limits what it relays.
+		class RelaySocket : public rtc::AsyncPacketSocket
+		{
+		public:
+			RelaySocket(rtc::AsyncPacketSocket* socket, int rate, TurnRelay::Counters* counters) :
+				socket_(socket),
+				toPeers_(rate),
+				fromPeers_(rate),
+				counters_(counters)
+			{
+				socket_->SignalReadPacket.connect(this, &RelaySocket::OnReadPacket);
+				socket_->SignalSentPacket.connect(this, &RelaySocket::OnSentPacket);
+				socket_->SignalReadyToSend.connect(this, &RelaySocket::OnReadyToSend);
+				counters_->allocations++;
+			}
+			~RelaySocket() override
+			{
+				counters_->allocations--;
+			}
+
+			rtc::SocketAddress GetLocalAddress() const override
+			{
+				return socket_->GetLocalAddress();
+			}
+			rtc::SocketAddress GetRemoteAddress() const override
+			{
+				return socket_->GetRemoteAddress();
+			}
+
+			int Send(const void* pv, size_t cb, const rtc::PacketOptions& options) override
+			{
+				return SendTo(pv, cb, GetRemoteAddress(), options);
+			}
+			int SendTo(const void* pv, size_t cb, const rtc::SocketAddress& addr, const rtc::PacketOptions& options) override
+			{
+				// Dropped like on a congested link, the client's congestion control backs off.
+				if (!toPeers_.Take(cb))
+				{
+					counters_->packetsThrottled++;
+					return static_cast<int>(cb);
+				}
+				const int sent = socket_->SendTo(pv, cb, addr, options);
+				if (sent > 0)
+					counters_->bytesToPeers += sent;
+				return sent;
+			}
+
+			int Close() override
+			{
+				return socket_->Close();
+			}
+			State GetState() const override
+			{
+				return socket_->GetState();
+			}
+			int GetOption(rtc::Socket::Option opt, int* value) override
+			{
+				return socket_->GetOption(opt, value);
+			}
+			int SetOption(rtc::Socket::Option opt, int value) override
+			{
+				return socket_->SetOption(opt, value);
+			}
+			int GetError() const override
+			{
+				return socket_->GetError();
+			}
+			void SetError(int error) override
+			{
+				socket_->SetError(error);
+			}
+
+		private:
+			void OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size, const rtc::SocketAddress& remote, const int64_t& packet_time_us)
+			{
+				if (!fromPeers_.Take(size))
+				{
+					counters_->packetsThrottled++;
+					return;
+				}
+				counters_->bytesFromPeers += size;
+				SignalReadPacket(this, data, size, remote, packet_time_us);
+			}
+			void OnSentPacket(rtc::AsyncPacketSocket* socket, const rtc::SentPacket& sent)
+			{
+				SignalSentPacket(this, sent);
+			}
+			void OnReadyToSend(rtc::AsyncPacketSocket* socket)
+			{
+				SignalReadyToSend(this);
+			}
+
+			std::unique_ptr<rtc::AsyncPacketSocket> socket_;
+			TokenBucket toPeers_;
+			TokenBucket fromPeers_;
+			TurnRelay::Counters* counters_;
+		};
+
+		class RelaySocketFactory : public rtc::BasicPacketSocketFactory
+		{
+		public:
+			RelaySocketFactory(rtc::Thread* thread, int rate, TurnRelay::Counters* counters) :
+				rtc::BasicPacketSocketFactory(thread),
+				rate_(rate),
+				counters_(counters)
+			{
+			}
+
+			rtc::AsyncPacketSocket* CreateUdpSocket(const rtc::SocketAddress& local_address, uint16_t min_port, uint16_t max_port) override
+			{
+				rtc::AsyncPacketSocket* socket = rtc::BasicPacketSocketFactory::CreateUdpSocket(local_address, min_port, max_port);
+				return socket ? new RelaySocket(socket, rate_, counters_) : nullptr;
+			}
+
+		private:
+			int rate_;
+			TurnRelay::Counters* counters_;
+		};
+	}
+
+	class TurnRelayShard
+	{
+	public:
+		bool Start(size_t index, TurnRelay* relay, TurnRelay::Counters* counters, const rtc::SocketAddress& internal, const rtc::IPAddress& external, const std::string& realm, int rate)
+		{
+			thread_ = rtc::Thread::CreateWithSocketServer();
+			thread_->SetName("spitfire_turn_" + std::to_string(index), nullptr);
+			thread_->Start();
+
+			// The server checks that it is only used on its own thread.
+			const bool started = thread_->Invoke<bool>(RTC_FROM_HERE, [&]()
+			{
+				rtc::AsyncUDPSocket* socket = rtc::AsyncUDPSocket::Create(thread_->socketserver(), internal);
+				if (!socket)
+					return false;
+
+				factory_.reset(new RelaySocketFactory(thread_.get(), rate, counters));
+				server_.reset(new cricket::TurnServer(thread_.get()));
+				server_->set_realm(realm);
+				server_->set_software("Spitfire");
+				server_->set_auth_hook(relay);
+				server_->AddInternalSocket(socket, cricket::PROTO_UDP);
+				server_->SetExternalSocketFactory(factory_.get(), rtc::SocketAddress(external, 0));
+				return true;
+			});
+			if (!started)
+			{
+				RTC_LOG(WARNING) << "Could not bind the TURN relay to " << internal.ToString();
+				Stop();
+			}
+			return started;
+		}
+
+		void Stop()
+		{
+			if (!thread_)
+				return;
+
+			thread_->Invoke<void>(RTC_FROM_HERE, [this]()
+			{
+				server_.reset();
+				factory_.reset();
+			});
+			thread_->Stop();
+			thread_.reset();
+		}
+
+	private:
+		std::unique_ptr<rtc::Thread> thread_;
+		// Only touched on |thread_|.
+		std::unique_ptr<RelaySocketFactory> factory_;
+		std::unique_ptr<cricket::TurnServer> server_;
+	};
+
+	TurnRelay& TurnRelay::Instance()
+	{
+		static TurnRelay* const relay = new TurnRelay();
+		return *relay;
+	}
+
+	TurnRelay::TurnRelay() = default;
+	TurnRelay::~TurnRelay() = default;
+
+	bool TurnRelay::Start(uint16_t port, const std::string& external_ip, size_t shards)
+	{
+		rtc::IPAddress external;
+		if (!rtc::IPFromString(external_ip, &external) || shards == 0 || port + shards - 1 > 0xFFFF)
+			return false;
+
+		std::string realm;
+		int rate_limit;
+		{
+			rtc::CritScope lock(&crit_);
+			if (!shards_.empty() || starting_)
+				return false;
+			starting_ = true;
+			realm = realm_;
+			rate_limit = rateLimit_;
+		}
+
+		// Started and rolled back outside the lock, a started shard may already be in GetKey.
+		std::vector<std::unique_ptr<TurnRelayShard>> started;
+		for (size_t i = 0; i < shards; i++)
+		{
+			auto shard = std::make_unique<TurnRelayShard>();
+			const rtc::SocketAddress internal(rtc::IPAddress(INADDR_ANY), static_cast<int>(port + i));
+			if (!shard->Start(i, this, &counters_, internal, external, realm, rate_limit))
+				break;
+			started.push_back(std::move(shard));
+		}
+
+		if (started.size() != shards)
+		{
+			for (auto const& shard : started)
+			{
+				shard->Stop();
+			}
+			rtc::CritScope lock(&crit_);
+			starting_ = false;
+			return false;
+		}
+
+		rtc::CritScope lock(&crit_);
+		shards_.swap(started);
+		starting_ = false;
+		return true;
+	}
+
+	void TurnRelay::Stop()
+	{
+		// Shards never call back into the relay under its lock, GetKey only runs on their threads.
+		std::vector<std::unique_ptr<TurnRelayShard>> shards;
+		{
+			rtc::CritScope lock(&crit_);
+			shards.swap(shards_);
+		}
+		for (auto const& shard : shards)
+		{
+			shard->Stop();
+		}
+	}
+
+	bool TurnRelay::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return !shards_.empty();
+	}
+
+	void TurnRelay::AddUser(const std::string& username, const std::string& password)
+	{
+		rtc::CritScope lock(&crit_);
+		passwords_[username] = password;
+	}
+
+	void TurnRelay::RemoveUser(const std::string& username)
+	{
+		rtc::CritScope lock(&crit_);
+		passwords_.erase(username);
+	}
+
+	void TurnRelay::SetRealm(const std::string& realm)
+	{
+		rtc::CritScope lock(&crit_);
+		realm_ = realm;
+	}
+
+	void TurnRelay::SetAllocationRateLimit(int bytes_per_second)
+	{
+		rtc::CritScope lock(&crit_);
+		rateLimit_ = std::max(0, bytes_per_second);
+	}
+
+	bool TurnRelay::GetKey(const std::string& username, const std::string& realm, std::string* key)
+	{
+		rtc::CritScope lock(&crit_);
+		auto password = passwords_.find(username);
+		return password != passwords_.end() && cricket::ComputeStunCredentialHash(username, realm, password->second, key);
+	}
+
+	RtcTurnRelayInfo TurnRelay::GetInfo()
+	{
+		auto info = RtcTurnRelayInfo();
+		rtc::CritScope lock(&crit_);
+
+		info.shards = static_cast<uint32_t>(shards_.size());
+		info.allocations = static_cast<uint32_t>(std::max(0, counters_.allocations.load()));
+		info.bytesToPeers = counters_.bytesToPeers;
+		info.bytesFromPeers = counters_.bytesFromPeers;
+		info.packetsThrottled = counters_.packetsThrottled;
+		return info;
+	}
+}
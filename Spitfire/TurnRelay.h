@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "p2p/base/turn_server.h"
+#include "rtc_base/critical_section.h"
+
+namespace Spitfire
+{
+	class TurnRelayShard;
+
+	struct RtcTurnRelayInfo
+	{
+		uint32_t shards;
+		uint32_t allocations;
+		uint64_t bytesToPeers;
+		uint64_t bytesFromPeers;
+		// Relayed packets dropped by the per allocation rate limit.
+		uint64_t packetsThrottled;
+	};
+
+	// In-process TURN relay on the vendored cricket::TurnServer, so one binary can be both
+	// endpoint and relay. Like the UDP mux, shard i runs its own server and thread on
+	// |port| + i, which keeps every allocation table small and owned by one thread.
+	class TurnRelay : public cricket::TurnAuthInterface
+	{
+	public:
+		struct Counters
+		{
+			std::atomic<int32_t> allocations{ 0 };
+			std::atomic<uint64_t> bytesToPeers{ 0 };
+			std::atomic<uint64_t> bytesFromPeers{ 0 };
+			std::atomic<uint64_t> packetsThrottled{ 0 };
+		};
+
+		static TurnRelay& Instance();
+
+		// Relayed addresses are bound on |external_ip|, which has to be a local address.
+		bool Start(uint16_t port, const std::string& external_ip, size_t shards);
+		void Stop();
+		bool IsRunning() const;
+
+		// Long term credentials, checked against every allocation request.
+		void AddUser(const std::string& username, const std::string& password);
+		void RemoveUser(const std::string& username);
+		// Both take effect on the next Start. A zero rate lifts the limit.
+		void SetRealm(const std::string& realm);
+		void SetAllocationRateLimit(int bytes_per_second);
+
+		RtcTurnRelayInfo GetInfo();
+
+		// Called on the shard threads.
+		bool GetKey(const std::string& username, const std::string& realm, std::string* key) override;
+
+	private:
+		TurnRelay();
+		~TurnRelay() override;
+
+		mutable rtc::CriticalSection crit_;
+		std::vector<std::unique_ptr<TurnRelayShard>> shards_;
+		// Set while Start brings up shards outside the lock.
+		bool starting_ = false;
+		std::map<std::string, std::string> passwords_;
+		std::string realm_ = "spitfire";
+		int rateLimit_ = 0;
+		Counters counters_;
+	};
+}
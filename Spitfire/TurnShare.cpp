@@ -0,0 +1,718 @@
+#include "TurnShare.h"
+#include "SocketBuffers.h"
+
+#include "api/transport/stun.h"
+#include "p2p/base/connection.h"
+#include "p2p/base/p2p_constants.h"
+#include "p2p/base/turn_port.h"
+#include "p2p/client/turn_port_factory.h"
+#include "rtc_base/byte_order.h"
+#include "rtc_base/helpers.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace Spitfire
+{
+	namespace
+	{
+		// First TURN channel number, RFC 5766.
+		const int kFirstChannel = 0x4000;
+		const int kLastChannel = 0x7FFF;
+		// A channel binding lasts 10 minutes after its last refresh and its number stays taken for
+		// 5 more (RFC 5766), on top of the 5 minutes TurnPort keeps a released entry alive.
+		const int64_t kChannelReuseMs = 20 * 60 * 1000;
+
+		// USERNAME of a check is "receiver ufrag:sender ufrag", the first half is ours.
+		bool ReadLocalUfrag(const char* data, size_t size, std::string* ufrag)
+		{
+			if (size < cricket::kStunHeaderSize || rtc::GetBE16(data) != cricket::STUN_BINDING_REQUEST)
+				return false;
+
+			const size_t end = std::min<size_t>(size, cricket::kStunHeaderSize + rtc::GetBE16(data + 2));
+			size_t offset = cricket::kStunHeaderSize;
+			while (offset + 4 <= end)
+			{
+				const uint16_t attribute = rtc::GetBE16(data + offset);
+				const uint16_t length = rtc::GetBE16(data + offset + 2);
+				if (offset + 4 + length > end)
+					return false;
+
+				if (attribute == cricket::STUN_ATTR_USERNAME)
+				{
+					const std::string username(data + offset + 4, length);
+					*ufrag = username.substr(0, username.find(':'));
+					return !ufrag->empty();
+				}
+				offset += 4 + ((length + 3) & ~3);
+			}
+			return false;
+		}
+
+		class SharedRelayPortFactory : public cricket::RelayPortFactoryInterface
+		{
+		public:
+			explicit SharedRelayPortFactory(TurnShare* share) :
+				share_(share)
+			{
+			}
+
+			std::unique_ptr<cricket::Port> Create(const cricket::CreateRelayPortArgs& args, rtc::AsyncPacketSocket* udp_socket) override
+			{
+				return fallback_.Create(args, udp_socket);
+			}
+
+			std::unique_ptr<cricket::Port> Create(const cricket::CreateRelayPortArgs& args, int min_port, int max_port) override;
+
+		private:
+			TurnShare* share_;
+			cricket::TurnPortFactory fallback_;
+		};
+	}
+
+	// The shared allocation. Connections live on the relay ports, this one only holds
+	// the permissions and channels, and hands every packet to the share.
+	class SharedTurnPort : public cricket::TurnPort
+	{
+	public:
+		SharedTurnPort(rtc::Thread* thread, rtc::PacketSocketFactory* factory, rtc::Network* network, const cricket::ProtocolAddress& server, const cricket::RelayServerConfig& config) :
+			cricket::TurnPort(thread, factory, network, 0, 0,
+				rtc::CreateRandomString(cricket::ICE_UFRAG_LENGTH), rtc::CreateRandomString(cricket::ICE_PWD_LENGTH),
+				server, config.credentials, config.priority, std::string(),
+				config.tls_alpn_protocols, config.tls_elliptic_curves, nullptr)
+		{
+			SetTurnLoggingId(config.turn_logging_id);
+		}
+
+		// Returns true when |remote| got a permission and channel it did not have.
+		bool AddPeer(const rtc::SocketAddress& remote)
+		{
+			if (channels_.find(remote) != channels_.end())
+				return false;
+
+			// A peer coming back while its entry is still around keeps its channel.
+			auto retired = std::find_if(retired_.begin(), retired_.end(), [&remote](const Retired& entry)
+			{
+				return entry.remote == remote;
+			});
+			const bool returning = retired != retired_.end();
+			int channel = 0;
+			if (returning)
+			{
+				channel = retired->channel;
+				retired_.erase(retired);
+			}
+			else
+			{
+				channel = NextChannel();
+			}
+
+			if (!CreateOrRefreshEntry(remote, channel) && !returning)
+			{
+				// An entry without a channel was still around, the new number was never bound.
+				if (channel != 0)
+					retired_.push_front(Retired{ rtc::SocketAddress(), channel, rtc::TimeMillis() - kChannelReuseMs });
+				channel = 0;
+			}
+			channels_[remote] = channel;
+			return true;
+		}
+
+		void RemovePeer(const rtc::SocketAddress& remote)
+		{
+			auto channel = channels_.find(remote);
+			if (channel == channels_.end())
+				return;
+
+			// TurnPort drops an entry, after its permission timeout, once a connection to its address
+			// is destroyed, and offers no other way to release one. The shared port has no connections
+			// of its own, so a stand-in tells it. This relies on libwebrtc internals:
+			// - HandleConnectionDestroyed only reads the remote address, and schedules the entry found
+			//   for it without a null check, so the entry must exist. SetEntryChannelId is the public
+			//   lookup, it keeps the channel the entry already has.
+			// - ProxyConnection's constructor registers nothing with the port, but logs its local
+			//   candidate, so the port needs one. Without it the allocation never succeeded and its
+			//   entries go when the failed port is destroyed.
+			if (!Candidates().empty() && SetEntryChannelId(remote, channel->second))
+			{
+				cricket::Candidate candidate;
+				candidate.set_address(remote);
+				cricket::ProxyConnection standIn(this, 0, candidate);
+				HandleConnectionDestroyed(&standIn);
+			}
+			if (channel->second != 0)
+				retired_.push_back(Retired{ remote, channel->second, rtc::TimeMillis() });
+			channels_.erase(channel);
+		}
+
+	private:
+		struct Retired
+		{
+			rtc::SocketAddress remote;
+			int channel;
+			int64_t sinceMs;
+		};
+
+		// Zero, a permission without channel, once every number is bound or still cooling down.
+		int NextChannel()
+		{
+			if (nextChannel_ <= kLastChannel)
+				return nextChannel_++;
+
+			const int64_t now = rtc::TimeMillis();
+			for (auto retired = retired_.begin(); retired != retired_.end(); ++retired)
+			{
+				if (now - retired->sinceMs >= kChannelReuseMs)
+				{
+					const int channel = retired->channel;
+					retired_.erase(retired);
+					return channel;
+				}
+			}
+			return 0;
+		}
+
+		int nextChannel_ = kFirstChannel;
+		std::map<rtc::SocketAddress, int> channels_;
+		// Oldest first.
+		std::deque<Retired> retired_;
+	};
+
+	// Relay port of one peer connection, on its network thread.
+	class SharedRelayPort : public cricket::Port
+	{
+	public:
+		SharedRelayPort(const cricket::CreateRelayPortArgs& args, TurnShare* share) :
+			cricket::Port(args.network_thread, cricket::RELAY_PORT_TYPE, args.socket_factory, args.network, args.username, args.password),
+			share_(share),
+			server_(*args.server_address),
+			config_(*args.config)
+		{
+		}
+
+		~SharedRelayPort() override
+		{
+			if (endpoint_)
+				share_->Detach(endpoint_);
+		}
+
+		void PrepareAddress() override
+		{
+			if (!endpoint_)
+				endpoint_ = share_->Attach(this, server_, config_, *Network());
+		}
+
+		cricket::Connection* CreateConnection(const cricket::Candidate& remote_candidate, CandidateOrigin origin) override
+		{
+			if (!SupportsProtocol(remote_candidate.protocol()) || remote_candidate.address().IsUnresolvedIP())
+				return nullptr;
+
+			for (size_t index = 0; index < Candidates().size(); index++)
+			{
+				if (Candidates()[index].address().family() != remote_candidate.address().family())
+					continue;
+
+				cricket::ProxyConnection* connection = new cricket::ProxyConnection(this, index, remote_candidate);
+				AddOrReplaceConnection(connection);
+				share_->AddPeer(endpoint_, remote_candidate.address());
+				return connection;
+			}
+			return nullptr;
+		}
+
+		int SendTo(const void* data, size_t size, const rtc::SocketAddress& addr, const rtc::PacketOptions& options, bool payload) override
+		{
+			if (!endpoint_ || Candidates().empty())
+			{
+				error_ = ENOTCONN;
+				return -1;
+			}
+			share_->SendTo(endpoint_, data, size, addr, options);
+			return static_cast<int>(size);
+		}
+
+		// Socket options belong to the shared allocation's socket, they are only remembered here.
+		int SetOption(rtc::Socket::Option opt, int value) override
+		{
+			options_[opt] = value;
+			return 0;
+		}
+
+		int GetOption(rtc::Socket::Option opt, int* value) override
+		{
+			auto option = options_.find(opt);
+			if (option == options_.end())
+				return -1;
+			*value = option->second;
+			return 0;
+		}
+
+		int GetError() override
+		{
+			return error_;
+		}
+
+		bool SupportsProtocol(const std::string& protocol) const override
+		{
+			return protocol == cricket::UDP_PROTOCOL_NAME;
+		}
+
+		cricket::ProtocolType GetProtocol() const override
+		{
+			return cricket::PROTO_UDP;
+		}
+
+		// Packets leave on the share thread, there is no socket of our own to report on.
+		void OnSentPacket(rtc::AsyncPacketSocket* socket, const rtc::SentPacket& sent_packet) override
+		{
+		}
+
+		void OnAllocated(const cricket::Candidate& relay)
+		{
+			if (!Candidates().empty())
+				return;
+
+			AddAddress(relay.address(), relay.address(), relay.related_address(),
+				cricket::UDP_PROTOCOL_NAME, cricket::UDP_PROTOCOL_NAME, std::string(), cricket::RELAY_PORT_TYPE,
+				cricket::ICE_TYPE_PREFERENCE_RELAY_UDP, config_.priority, relay.url(), true);
+		}
+
+		void OnFailed()
+		{
+			error_ = ENOTCONN;
+			SignalPortError(this);
+		}
+
+		void Deliver(const char* data, size_t size, const rtc::SocketAddress& remote)
+		{
+			if (cricket::Connection* connection = GetConnection(remote))
+				connection->OnReadPacket(data, size, rtc::TimeMicros());
+			else
+				cricket::Port::OnReadPacket(data, size, remote, cricket::PROTO_UDP);
+		}
+
+	private:
+		TurnShare* share_;
+		const cricket::ProtocolAddress server_;
+		const cricket::RelayServerConfig config_;
+		std::shared_ptr<TurnShare::Endpoint> endpoint_;
+		std::map<rtc::Socket::Option, int> options_;
+		int error_ = 0;
+	};
+
+	namespace
+	{
+		std::unique_ptr<cricket::Port> SharedRelayPortFactory::Create(const cricket::CreateRelayPortArgs& args, int min_port, int max_port)
+		{
+			if (args.server_address->proto != cricket::PROTO_UDP)
+				return fallback_.Create(args, min_port, max_port);
+			return std::unique_ptr<cricket::Port>(new SharedRelayPort(args, share_));
+		}
+	}
+
+	TurnShare& TurnShare::Instance()
+	{
+		static TurnShare* const share = new TurnShare();
+		return *share;
+	}
+
+	void TurnShare::Start()
+	{
+		rtc::CritScope lock(&crit_);
+		if (thread_)
+			return;
+
+		thread_ = rtc::Thread::CreateWithSocketServer();
+		thread_->SetName("spitfire_turn_share", nullptr);
+		thread_->Start();
+		thread_->PostTask(RTC_FROM_HERE, [this]()
+		{
+			factory_.reset(new BufferedPacketSocketFactory(rtc::Thread::Current(), RtcSocketBufferSizes()));
+		});
+	}
+
+	void TurnShare::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+		}
+		if (!thread)
+			return;
+
+		// Relay ports still riding on an allocation stop sending, their peers fail over to other candidates.
+		thread->Invoke<void>(RTC_FROM_HERE, [this]()
+		{
+			DestroyAllocations();
+			factory_.reset();
+		});
+		thread->Stop();
+	}
+
+	bool TurnShare::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return thread_ != nullptr;
+	}
+
+	std::unique_ptr<cricket::RelayPortFactoryInterface> TurnShare::CreateRelayPortFactory()
+	{
+		if (!IsRunning())
+			return nullptr;
+		return std::unique_ptr<cricket::RelayPortFactoryInterface>(new SharedRelayPortFactory(this));
+	}
+
+	std::shared_ptr<TurnShare::Endpoint> TurnShare::Attach(SharedRelayPort* port, const cricket::ProtocolAddress& server, const cricket::RelayServerConfig& config, const rtc::Network& network)
+	{
+		auto endpoint = std::make_shared<Endpoint>();
+		endpoint->thread = rtc::Thread::Current();
+		endpoint->ufrag = port->username_fragment();
+		endpoint->port = port;
+
+		const std::string key = server.address.ToString() + "|" + config.credentials.username + "|" + config.credentials.password + "|" +
+			std::to_string(config.priority) + "|" + network.name() + "|" + network.GetBestIP().ToString();
+		const NetworkInfo info = Describe(network);
+
+		rtc::CritScope lock(&crit_);
+		portCount_++;
+		if (!thread_)
+		{
+			PostFailed(endpoint);
+			return endpoint;
+		}
+
+		thread_->PostTask(RTC_FROM_HERE, [this, endpoint, key, server, config, info]()
+		{
+			Join(endpoint, key, server, config, info);
+		});
+		return endpoint;
+	}
+
+	void TurnShare::Detach(const std::shared_ptr<Endpoint>& endpoint)
+	{
+		// Tasks already posted check |port| on this thread.
+		endpoint->port = nullptr;
+
+		rtc::CritScope lock(&crit_);
+		if (endpoint->released)
+			return;
+
+		endpoint->released = true;
+		portCount_--;
+		if (thread_)
+		{
+			std::shared_ptr<Endpoint> target = endpoint;
+			thread_->PostTask(RTC_FROM_HERE, [this, target]()
+			{
+				Leave(target);
+			});
+		}
+	}
+
+	void TurnShare::AddPeer(const std::shared_ptr<Endpoint>& endpoint, const rtc::SocketAddress& remote)
+	{
+		rtc::CritScope lock(&crit_);
+		if (!thread_ || !endpoint)
+			return;
+
+		std::shared_ptr<Endpoint> target = endpoint;
+		thread_->PostTask(RTC_FROM_HERE, [this, target, remote]()
+		{
+			Allocation* allocation = target->allocation;
+			if (!allocation)
+				return;
+
+			AddRoute(allocation, remote, target);
+			if (allocation->port->AddPeer(remote))
+				peers_++;
+		});
+	}
+
+	void TurnShare::SendTo(const std::shared_ptr<Endpoint>& endpoint, const void* data, size_t size, const rtc::SocketAddress& remote, const rtc::PacketOptions& options)
+	{
+		rtc::CritScope lock(&crit_);
+		if (!thread_ || endpoint->released)
+		{
+			packetsDropped_++;
+			return;
+		}
+
+		std::shared_ptr<Endpoint> target = endpoint;
+		rtc::CopyOnWriteBuffer packet(static_cast<const uint8_t*>(data), size);
+		thread_->PostTask(RTC_FROM_HERE, [this, target, packet, remote, options]()
+		{
+			Allocation* allocation = target->allocation;
+			if (!allocation || !allocation->ready || allocation->port->SendTo(packet.cdata(), packet.size(), remote, options, true) < 0)
+			{
+				packetsDropped_++;
+				return;
+			}
+			packetsSent_++;
+		});
+	}
+
+	void TurnShare::Join(const std::shared_ptr<Endpoint>& endpoint, const std::string& key, const cricket::ProtocolAddress& server, const cricket::RelayServerConfig& config, const NetworkInfo& network)
+	{
+		{
+			rtc::CritScope lock(&crit_);
+			if (endpoint->released)
+				return;
+		}
+
+		auto& allocation = allocations_[key];
+		if (!allocation)
+		{
+			allocation.reset(new Allocation());
+			allocation->key = key;
+			allocation->network = CreateNetwork(network);
+			allocation->port.reset(new SharedTurnPort(rtc::Thread::Current(), factory_.get(), allocation->network.get(), server, config));
+			allocation->port->SignalCandidateReady.connect(this, &TurnShare::OnCandidateReady);
+			allocation->port->SignalPortError.connect(this, &TurnShare::OnPortError);
+			allocation->port->SignalReadPacket.connect(this, &TurnShare::OnReadPacket);
+			allocation->port->EnablePortPackets();
+			allocationCount_++;
+
+			// Connected first so a failure right away still reaches this endpoint.
+			endpoint->allocation = allocation.get();
+			allocation->endpoints.push_back(endpoint);
+			allocation->port->PrepareAddress();
+			return;
+		}
+
+		endpoint->allocation = allocation.get();
+		allocation->endpoints.push_back(endpoint);
+		if (allocation->ready)
+			PostAllocated(endpoint, allocation->candidate);
+	}
+
+	void TurnShare::Leave(const std::shared_ptr<Endpoint>& endpoint)
+	{
+		Allocation* allocation = endpoint->allocation;
+		if (!allocation)
+			return;
+		endpoint->allocation = nullptr;
+
+		auto& endpoints = allocation->endpoints;
+		endpoints.erase(std::remove(endpoints.begin(), endpoints.end(), endpoint), endpoints.end());
+		if (!endpoints.empty())
+		{
+			for (auto peer = allocation->peers.begin(); peer != allocation->peers.end();)
+			{
+				auto& users = peer->second;
+				users.erase(std::remove_if(users.begin(), users.end(), [&endpoint](const std::weak_ptr<Endpoint>& user)
+				{
+					auto alive = user.lock();
+					return !alive || alive == endpoint;
+				}), users.end());
+				if (!users.empty())
+				{
+					++peer;
+					continue;
+				}
+
+				// Nobody talks to this remote any more, its permission and channel can go.
+				allocation->port->RemovePeer(peer->first);
+				peer = allocation->peers.erase(peer);
+			}
+			return;
+		}
+
+		// The last user is gone, destroying the port releases the allocation on the server.
+		allocationCount_--;
+		allocations_.erase(allocation->key);
+	}
+
+	void TurnShare::AddRoute(Allocation* allocation, const rtc::SocketAddress& remote, const std::shared_ptr<Endpoint>& endpoint)
+	{
+		auto& users = allocation->peers[remote];
+		users.erase(std::remove_if(users.begin(), users.end(), [&endpoint](const std::weak_ptr<Endpoint>& user)
+		{
+			auto alive = user.lock();
+			return !alive || alive == endpoint;
+		}), users.end());
+		users.push_back(endpoint);
+	}
+
+	TurnShare::NetworkInfo TurnShare::Describe(const rtc::Network& network)
+	{
+		NetworkInfo info;
+		info.name = network.name();
+		info.description = network.description();
+		info.prefix = network.prefix();
+		info.prefixLength = network.prefix_length();
+		info.type = network.type();
+		info.underlyingType = network.underlying_type_for_vpn();
+		info.scopeId = network.scope_id();
+		info.id = network.id();
+		info.ips = network.GetIPs();
+		return info;
+	}
+
+	std::unique_ptr<rtc::Network> TurnShare::CreateNetwork(const NetworkInfo& info)
+	{
+		std::unique_ptr<rtc::Network> network(new rtc::Network(info.name, info.description, info.prefix, info.prefixLength, info.type));
+		network->set_underlying_type_for_vpn(info.underlyingType);
+		network->set_scope_id(info.scopeId);
+		network->set_id(info.id);
+		for (auto const& ip : info.ips)
+		{
+			network->AddIP(ip);
+		}
+		return network;
+	}
+
+	TurnShare::Allocation* TurnShare::Find(cricket::PortInterface* port)
+	{
+		for (auto const& allocation : allocations_)
+		{
+			if (allocation.second->port.get() == port)
+				return allocation.second.get();
+		}
+		return nullptr;
+	}
+
+	void TurnShare::OnCandidateReady(cricket::Port* port, const cricket::Candidate& candidate)
+	{
+		Allocation* allocation = Find(port);
+		if (!allocation || candidate.type() != cricket::RELAY_PORT_TYPE || allocation->ready)
+			return;
+
+		allocation->ready = true;
+		allocation->candidate = candidate;
+		for (auto const& endpoint : allocation->endpoints)
+		{
+			PostAllocated(endpoint, candidate);
+		}
+	}
+
+	void TurnShare::OnPortError(cricket::Port* port)
+	{
+		Allocation* allocation = Find(port);
+		if (!allocation)
+			return;
+
+		RTC_LOG(WARNING) << "Shared TURN allocation on " << allocation->port->server_address().address.ToString() << " failed.";
+		for (auto const& endpoint : allocation->endpoints)
+		{
+			endpoint->allocation = nullptr;
+			PostFailed(endpoint);
+		}
+
+		// The port is still inside its own signal, it is deleted once that returned.
+		const std::string key = allocation->key;
+		failed_.push_back(std::move(allocations_[key]));
+		allocations_.erase(key);
+		allocationCount_--;
+		rtc::Thread::Current()->PostTask(RTC_FROM_HERE, [this]()
+		{
+			failed_.clear();
+		});
+	}
+
+	void TurnShare::OnReadPacket(cricket::PortInterface* port, const char* data, size_t size, const rtc::SocketAddress& remote)
+	{
+		Allocation* allocation = Find(port);
+		if (!allocation)
+			return;
+
+		std::shared_ptr<Endpoint> endpoint;
+		auto peer = allocation->peers.find(remote);
+		if (peer != allocation->peers.end() && !peer->second.empty())
+			endpoint = peer->second.back().lock();
+
+		// A check from an address no relay port knows yet, e.g. a peer reflexive candidate.
+		std::string ufrag;
+		if (!endpoint && ReadLocalUfrag(data, size, &ufrag))
+		{
+			for (auto const& candidate : allocation->endpoints)
+			{
+				if (candidate->ufrag == ufrag)
+				{
+					endpoint = candidate;
+					AddRoute(allocation, remote, endpoint);
+					break;
+				}
+			}
+		}
+
+		if (!endpoint)
+		{
+			packetsDropped_++;
+			return;
+		}
+		packetsReceived_++;
+		PostPacket(endpoint, rtc::CopyOnWriteBuffer(data, size), remote);
+	}
+
+	void TurnShare::DestroyAllocations()
+	{
+		for (auto const& allocation : allocations_)
+		{
+			for (auto const& endpoint : allocation.second->endpoints)
+			{
+				endpoint->allocation = nullptr;
+			}
+		}
+		allocations_.clear();
+		failed_.clear();
+		allocationCount_ = 0;
+	}
+
+	void TurnShare::PostAllocated(const std::shared_ptr<Endpoint>& endpoint, const cricket::Candidate& candidate)
+	{
+		rtc::CritScope lock(&crit_);
+		if (endpoint->released)
+			return;
+
+		std::shared_ptr<Endpoint> target = endpoint;
+		endpoint->thread->PostTask(RTC_FROM_HERE, [target, candidate]()
+		{
+			if (target->port)
+				target->port->OnAllocated(candidate);
+		});
+	}
+
+	void TurnShare::PostFailed(const std::shared_ptr<Endpoint>& endpoint)
+	{
+		rtc::CritScope lock(&crit_);
+		if (endpoint->released)
+			return;
+
+		std::shared_ptr<Endpoint> target = endpoint;
+		endpoint->thread->PostTask(RTC_FROM_HERE, [target]()
+		{
+			if (target->port)
+				target->port->OnFailed();
+		});
+	}
+
+	void TurnShare::PostPacket(const std::shared_ptr<Endpoint>& endpoint, const rtc::CopyOnWriteBuffer& data, const rtc::SocketAddress& remote)
+	{
+		rtc::CritScope lock(&crit_);
+		if (endpoint->released)
+			return;
+
+		std::shared_ptr<Endpoint> target = endpoint;
+		rtc::CopyOnWriteBuffer packet = data;
+		endpoint->thread->PostTask(RTC_FROM_HERE, [target, packet, remote]()
+		{
+			if (target->port)
+				target->port->Deliver(packet.cdata<char>(), packet.size(), remote);
+		});
+	}
+
+	RtcTurnShareInfo TurnShare::GetInfo()
+	{
+		auto info = RtcTurnShareInfo();
+		info.allocations = allocationCount_;
+		info.ports = portCount_;
+		info.peers = peers_;
+		info.packetsSent = packetsSent_;
+		info.packetsReceived = packetsReceived_;
+		info.packetsDropped = packetsDropped_;
+		return info;
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "p2p/base/port.h"
+#include "p2p/base/port_allocator.h"
+#include "p2p/client/relay_port_factory_interface.h"
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+namespace Spitfire
+{
+	class SharedRelayPort;
+	class SharedTurnPort;
+
+	struct RtcTurnShareInfo
+	{
+		// TURN allocations held, and the relay ports of peer connections riding on them.
+		uint32_t allocations;
+		uint32_t ports;
+		// Remote peers that got a permission and channel on a shared allocation.
+		uint64_t peers;
+		uint64_t packetsSent;
+		uint64_t packetsReceived;
+		uint64_t packetsDropped;
+	};
+
+	// Shares one TURN allocation per server, credentials and local network between
+	// every peer connection, instead of an allocation per peer connection. Each peer
+	// connection still gets its own relay port with its own ICE credentials and
+	// connections, the shared allocation only adds a permission and channel per
+	// remote peer. Incoming data is routed by remote address, the first check from a
+	// new address by the local ICE ufrag in USERNAME.
+	// Conductors run their own network threads, so the allocations live on one thread
+	// of the share and packets hop between it and the conductors.
+	class TurnShare : public sigslot::has_slots<>
+	{
+	public:
+		static TurnShare& Instance();
+
+		void Start();
+		void Stop();
+		bool IsRunning() const;
+
+		// Relay port factory for one conductor, null when not running. TURN over TCP or TLS
+		// and ports on a shared socket keep an allocation of their own.
+		std::unique_ptr<cricket::RelayPortFactoryInterface> CreateRelayPortFactory();
+
+		RtcTurnShareInfo GetInfo();
+
+	private:
+		friend class SharedRelayPort;
+
+		struct Allocation;
+
+		// A peer connection's network as the share thread rebuilds it. rtc::Network is never copied,
+		// the copy would carry the signal the peer connection's ports are connected to.
+		struct NetworkInfo
+		{
+			std::string name;
+			std::string description;
+			rtc::IPAddress prefix;
+			int prefixLength = 0;
+			rtc::AdapterType type = rtc::ADAPTER_TYPE_UNKNOWN;
+			rtc::AdapterType underlyingType = rtc::ADAPTER_TYPE_UNKNOWN;
+			int scopeId = 0;
+			uint16_t id = 0;
+			std::vector<rtc::InterfaceAddress> ips;
+		};
+
+		struct Endpoint
+		{
+			rtc::Thread* thread;
+			std::string ufrag;
+			// Set under |crit_| once released, nothing is posted to |thread| after that.
+			bool released = false;
+			// Only touched on the share thread.
+			Allocation* allocation = nullptr;
+			// Only touched on |thread|.
+			SharedRelayPort* port = nullptr;
+		};
+
+		struct Allocation
+		{
+			std::string key;
+			std::unique_ptr<rtc::Network> network;
+			std::unique_ptr<SharedTurnPort> port;
+			bool ready = false;
+			cricket::Candidate candidate;
+			std::vector<std::shared_ptr<Endpoint>> endpoints;
+			// Relay ports talking to each remote, the latest one gets its packets. The
+			// remote's permission and channel go when the last one leaves.
+			std::map<rtc::SocketAddress, std::vector<std::weak_ptr<Endpoint>>> peers;
+		};
+
+		TurnShare() = default;
+
+		// Called on the relay port's network thread.
+		std::shared_ptr<Endpoint> Attach(SharedRelayPort* port, const cricket::ProtocolAddress& server, const cricket::RelayServerConfig& config, const rtc::Network& network);
+		void Detach(const std::shared_ptr<Endpoint>& endpoint);
+		void AddPeer(const std::shared_ptr<Endpoint>& endpoint, const rtc::SocketAddress& remote);
+		void SendTo(const std::shared_ptr<Endpoint>& endpoint, const void* data, size_t size, const rtc::SocketAddress& remote, const rtc::PacketOptions& options);
+
+		// Run on the share thread.
+		void Join(const std::shared_ptr<Endpoint>& endpoint, const std::string& key, const cricket::ProtocolAddress& server, const cricket::RelayServerConfig& config, const NetworkInfo& network);
+		void Leave(const std::shared_ptr<Endpoint>& endpoint);
+		void OnCandidateReady(cricket::Port* port, const cricket::Candidate& candidate);
+		void OnPortError(cricket::Port* port);
+		void OnReadPacket(cricket::PortInterface* port, const char* data, size_t size, const rtc::SocketAddress& remote);
+		Allocation* Find(cricket::PortInterface* port);
+		static void AddRoute(Allocation* allocation, const rtc::SocketAddress& remote, const std::shared_ptr<Endpoint>& endpoint);
+		static NetworkInfo Describe(const rtc::Network& network);
+		static std::unique_ptr<rtc::Network> CreateNetwork(const NetworkInfo& info);
+		void DestroyAllocations();
+
+		// Post to the endpoint's thread unless it was released.
+		void PostAllocated(const std::shared_ptr<Endpoint>& endpoint, const cricket::Candidate& candidate);
+		void PostFailed(const std::shared_ptr<Endpoint>& endpoint);
+		void PostPacket(const std::shared_ptr<Endpoint>& endpoint, const rtc::CopyOnWriteBuffer& data, const rtc::SocketAddress& remote);
+
+		mutable rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		// Only touched on |thread_|.
+		std::unique_ptr<rtc::PacketSocketFactory> factory_;
+		std::map<std::string, std::unique_ptr<Allocation>> allocations_;
+		std::vector<std::unique_ptr<Allocation>> failed_;
+
+		std::atomic<uint32_t> allocationCount_{ 0 };
+		std::atomic<uint32_t> portCount_{ 0 };
+		std::atomic<uint64_t> peers_{ 0 };
+		std::atomic<uint64_t> packetsSent_{ 0 };
+		std::atomic<uint64_t> packetsReceived_{ 0 };
+		std::atomic<uint64_t> packetsDropped_{ 0 };
+	};
+}
@@ -0,0 +1,743 @@
+#include "UdpMux.h"
+#include "UdpOffload.h"
+#include "StunResponder.h"
+#include "api/transport/stun.h"
+#include "p2p/base/basic_packet_socket_factory.h"
+#include "rtc_base/async_udp_socket.h"
+#include "rtc_base/buffer.h"
+#include "rtc_base/byte_order.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+#include <algorithm>
+
+namespace Spitfire
+{
+	namespace
+	{
+		bool ReadStunType(const char* data, size_t size, uint16_t* type)
+		{
+			if (size < cricket::kStunHeaderSize)
+				return false;
+
+			*type = rtc::GetBE16(data);
+			return (*type & 0xC000) == 0 &&
+				rtc::GetBE32(data + 4) == cricket::kStunMagicCookie &&
+				cricket::kStunHeaderSize + rtc::GetBE16(data + 2) <= size;
+		}
+
+		bool IsStunRequest(uint16_t type)
+		{
+			return (type & 0x0110) == 0;
+		}
+
+		bool IsStunResponse(uint16_t type)
+		{
+			return (type & 0x0100) != 0;
+		}
+
+		// USERNAME of a check is "receiver ufrag:sender ufrag", the first half is ours.
+		bool ReadLocalUfrag(const char* data, size_t size, std::string* ufrag)
+		{
+			const size_t end = cricket::kStunHeaderSize + rtc::GetBE16(data + 2);
+			size_t offset = cricket::kStunHeaderSize;
+			while (offset + 4 <= end)
+			{
+				const uint16_t attribute = rtc::GetBE16(data + offset);
+				const uint16_t length = rtc::GetBE16(data + offset + 2);
+				if (offset + 4 + length > end)
+					return false;
+
+				if (attribute == cricket::STUN_ATTR_USERNAME)
+				{
+					const std::string username(data + offset + 4, length);
+					*ufrag = username.substr(0, username.find(':'));
+					return !ufrag->empty();
+				}
+				offset += 4 + ((length + 3) & ~3);
+			}
+			return false;
+		}
+
+		std::string TransactionId(const char* data)
+		{
+			return std::string(data + cricket::kStunTransactionIdOffset, cricket::kStunTransactionIdLength);
+		}
+	}
+
+	// One peer connection's view of a shared socket, lives on its network thread.
+	class UdpMuxSocket : public rtc::AsyncPacketSocket
+	{
+	public:
+		UdpMuxSocket(UdpMuxShard* mux, std::shared_ptr<UdpMuxShard::Endpoint> endpoint) :
+			mux_(mux),
+			endpoint_(std::move(endpoint))
+		{
+			endpoint_->socket = this;
+		}
+		~UdpMuxSocket() override
+		{
+			endpoint_->socket = nullptr;
+			mux_->ReleaseEndpoint(endpoint_);
+		}
+
+		rtc::SocketAddress GetLocalAddress() const override
+		{
+			return endpoint_->shared->address;
+		}
+		rtc::SocketAddress GetRemoteAddress() const override
+		{
+			return rtc::SocketAddress();
+		}
+
+		int Send(const void* pv, size_t cb, const rtc::PacketOptions& options) override
+		{
+			// UDP ports only ever send with an explicit destination.
+			error_ = ENOTCONN;
+			return -1;
+		}
+		int SendTo(const void* pv, size_t cb, const rtc::SocketAddress& addr, const rtc::PacketOptions& options) override
+		{
+			if (closed_)
+			{
+				error_ = ENOTCONN;
+				return -1;
+			}
+			mux_->SendTo(endpoint_, pv, cb, addr, options);
+
+			rtc::SentPacket sent(options.packet_id, rtc::TimeMillis(), options.info_signaled_after_sent);
+			sent.info.packet_size_bytes = cb;
+			SignalSentPacket(this, sent);
+			return static_cast<int>(cb);
+		}
+
+		int Close() override
+		{
+			closed_ = true;
+			return 0;
+		}
+		State GetState() const override
+		{
+			return closed_ ? STATE_CLOSED : STATE_BOUND;
+		}
+
+		// Options belong to the shared socket and are not changed per peer.
+		int GetOption(rtc::Socket::Option opt, int* value) override
+		{
+			return -1;
+		}
+		int SetOption(rtc::Socket::Option opt, int value) override
+		{
+			return 0;
+		}
+
+		int GetError() const override
+		{
+			return error_;
+		}
+		void SetError(int error) override
+		{
+			error_ = error;
+		}
+
+		void Deliver(const rtc::CopyOnWriteBuffer& packet, const rtc::SocketAddress& remote, int64_t packet_time_us)
+		{
+			if (!closed_)
+				SignalReadPacket(this, packet.data<char>(), packet.size(), remote, packet_time_us);
+		}
+
+	private:
+		UdpMuxShard* mux_;
+		std::shared_ptr<UdpMuxShard::Endpoint> endpoint_;
+		bool closed_ = false;
+		int error_ = 0;
+	};
+
+	class UdpMuxSocketFactory : public BufferedPacketSocketFactory
+	{
+	public:
+		UdpMuxSocketFactory(UdpMuxShard* mux, RtcConductor* conductor, rtc::Thread* network_thread, const RtcSocketBufferSizes& buffers) :
+			BufferedPacketSocketFactory(network_thread, buffers),
+			mux_(mux),
+			conductor_(conductor),
+			networkThread_(network_thread)
+		{
+		}
+
+		rtc::AsyncPacketSocket* CreateUdpSocket(const rtc::SocketAddress& local_address, uint16_t min_port, uint16_t max_port) override
+		{
+			auto endpoint = mux_->CreateEndpoint(conductor_, networkThread_, local_address.ipaddr());
+			if (!endpoint)
+				return BufferedPacketSocketFactory::CreateUdpSocket(local_address, min_port, max_port);
+			return new UdpMuxSocket(mux_, endpoint);
+		}
+
+	private:
+		UdpMuxShard* mux_;
+		RtcConductor* conductor_;
+		rtc::Thread* networkThread_;
+	};
+
+	UdpMuxShard::UdpMuxShard(size_t index) :
+		index_(index)
+	{
+	}
+
+	void UdpMuxShard::Start(uint16_t port, const RtcUdpMuxOptions& options)
+	{
+		rtc::CritScope lock(&crit_);
+		RTC_DCHECK(!thread_);
+
+		// Shared sockets are created directly on the socket server to reach their offload options.
+		auto server = std::make_unique<rtc::PhysicalSocketServer>();
+		socketServer_ = server.get();
+		thread_.reset(new rtc::Thread(std::move(server)));
+		thread_->SetName("spitfire_udp_mux_" + std::to_string(index_), nullptr);
+		thread_->Start();
+		port_ = port;
+		options_ = options;
+	}
+
+	void UdpMuxShard::Stop()
+	{
+		std::unique_ptr<rtc::Thread> thread;
+		std::map<rtc::IPAddress, std::shared_ptr<SharedSocket>> sockets;
+		{
+			rtc::CritScope lock(&crit_);
+			thread = std::move(thread_);
+			socketServer_ = nullptr;
+			sockets.swap(sockets_);
+			remotes_.clear();
+			transactions_.clear();
+		}
+		if (!thread)
+			return;
+
+		// Peers still holding an endpoint see a closed socket from here on.
+		thread->Invoke<void>(RTC_FROM_HERE, [&sockets]()
+		{
+			for (auto const& shared : sockets)
+			{
+				shared.second->offload = nullptr;
+				shared.second->socket.reset();
+			}
+		});
+		thread->Stop();
+	}
+
+	std::unique_ptr<rtc::PacketSocketFactory> UdpMuxShard::CreateSocketFactory(RtcConductor* conductor, rtc::Thread* network_thread, const RtcSocketBufferSizes& buffers)
+	{
+		return std::unique_ptr<rtc::PacketSocketFactory>(new UdpMuxSocketFactory(this, conductor, network_thread, buffers));
+	}
+
+	std::shared_ptr<UdpMuxShard::Endpoint> UdpMuxShard::CreateEndpoint(RtcConductor* conductor, rtc::Thread* network_thread, const rtc::IPAddress& ip)
+	{
+		rtc::Thread* thread;
+		rtc::PhysicalSocketServer* server;
+		uint16_t port;
+		RtcUdpMuxOptions options;
+		std::shared_ptr<SharedSocket> shared;
+		{
+			rtc::CritScope lock(&crit_);
+			if (!thread_)
+				return nullptr;
+
+			for (auto const& existing : endpoints_[conductor])
+			{
+				auto endpoint = existing.lock();
+				if (endpoint && endpoint->shared->address.ipaddr() == ip)
+					return nullptr;
+			}
+
+			auto it = sockets_.find(ip);
+			if (it != sockets_.end())
+				shared = it->second;
+			thread = thread_.get();
+			server = socketServer_;
+			port = port_;
+			options = options_;
+		}
+
+		// The shared socket is bound on the mux thread, without holding the lock
+		// that thread needs for every packet it reads.
+		if (!shared)
+		{
+			auto created = std::make_shared<SharedSocket>();
+			thread->Invoke<void>(RTC_FROM_HERE, [this, &created, server, &ip, port, &options]()
+			{
+				auto socket = std::make_unique<UdpOffloadSocket>(server);
+				if (!socket->Create(ip.family(), SOCK_DGRAM) || socket->Bind(rtc::SocketAddress(ip, port)) < 0)
+					return;
+
+				socket->EnableOffload(options.offload, options.offload);
+				created->offload = socket.get();
+				created->socket.reset(new rtc::AsyncUDPSocket(socket.release()));
+				SocketBuffers::Apply(created->socket.get(), options.buffers);
+				created->address = created->socket->GetLocalAddress();
+				created->socket->SignalReadPacket.connect(this, &UdpMuxShard::OnReadPacket);
+			});
+			if (!created->socket)
+			{
+				RTC_LOG(WARNING) << "Could not bind the UDP mux port " << port << " on " << ip.ToString();
+				return nullptr;
+			}
+
+			rtc::CritScope lock(&crit_);
+			shared = sockets_.emplace(ip, created).first->second;
+			if (shared != created)
+			{
+				// Another network thread bound this address first.
+				thread->PostTask(RTC_FROM_HERE, [created]()
+				{
+					created->socket.reset();
+				});
+			}
+		}
+
+		auto endpoint = std::make_shared<Endpoint>();
+		endpoint->conductor = conductor;
+		endpoint->thread = network_thread;
+		endpoint->shared = shared;
+
+		rtc::CritScope lock(&crit_);
+		endpoints_[conductor].push_back(endpoint);
+		return endpoint;
+	}
+
+	void UdpMuxShard::ReleaseEndpoint(const std::shared_ptr<Endpoint>& endpoint)
+	{
+		rtc::CritScope lock(&crit_);
+		endpoint->released = true;
+
+		// Routes another endpoint took over since stay with it.
+		for (auto const& remote : endpoint->remotes)
+		{
+			auto route = remotes_.find(std::make_pair(endpoint->shared.get(), remote));
+			if (route == remotes_.end())
+				continue;
+
+			auto owner = route->second.lock();
+			if (!owner || owner == endpoint)
+				remotes_.erase(route);
+		}
+		endpoint->remotes.clear();
+
+		auto it = endpoints_.find(endpoint->conductor);
+		if (it == endpoints_.end())
+			return;
+
+		auto& endpoints = it->second;
+		for (auto existing = endpoints.begin(); existing != endpoints.end();)
+		{
+			auto alive = existing->lock();
+			if (!alive || alive == endpoint)
+				existing = endpoints.erase(existing);
+			else
+				++existing;
+		}
+		if (endpoints.empty())
+			endpoints_.erase(it);
+	}
+
+	void UdpMuxShard::ClaimRemote(const std::shared_ptr<Endpoint>& endpoint, const rtc::SocketAddress& remote)
+	{
+		if (endpoint->released)
+			return;
+
+		auto& route = remotes_[std::make_pair(endpoint->shared.get(), remote)];
+		if (route.lock() == endpoint)
+			return;
+
+		route = endpoint;
+		endpoint->remotes.insert(remote);
+	}
+
+	void UdpMuxShard::RegisterUfrag(RtcConductor* conductor, const std::string& ufrag)
+	{
+		rtc::CritScope lock(&crit_);
+		ufrags_[ufrag] = conductor;
+	}
+
+	void UdpMuxShard::RemoveConductor(RtcConductor* conductor)
+	{
+		rtc::CritScope lock(&crit_);
+		for (auto it = ufrags_.begin(); it != ufrags_.end();)
+		{
+			if (it->second == conductor)
+				it = ufrags_.erase(it);
+			else
+				++it;
+		}
+	}
+
+	void UdpMuxShard::TrackTransaction(const std::shared_ptr<Endpoint>& endpoint, const char* data, size_t size)
+	{
+		uint16_t type;
+		if (!ReadStunType(data, size, &type) || !IsStunRequest(type))
+			return;
+
+		const int64_t now = rtc::TimeMillis();
+		if (transactions_.size() >= kMaxTransactions)
+		{
+			for (auto it = transactions_.begin(); it != transactions_.end();)
+			{
+				if (now - it->second.sentMs > kTransactionTimeoutMs)
+					it = transactions_.erase(it);
+				else
+					++it;
+			}
+			if (transactions_.size() >= kMaxTransactions)
+				transactions_.clear();
+		}
+		transactions_[TransactionId(data)] = Transaction{ endpoint, now };
+	}
+
+	void UdpMuxShard::SendTo(const std::shared_ptr<Endpoint>& endpoint, const void* data, size_t size, const rtc::SocketAddress& remote, const rtc::PacketOptions& options)
+	{
+		const char* bytes = static_cast<const char*>(data);
+		rtc::CopyOnWriteBuffer packet(bytes, size);
+		auto shared = endpoint->shared;
+		const rtc::DiffServCodePoint dscp = options.dscp;
+
+		rtc::CritScope lock(&crit_);
+		if (!thread_)
+		{
+			packetsDropped_++;
+			return;
+		}
+
+		// Replies from |remote| are routed back to whoever talked to it last.
+		ClaimRemote(endpoint, remote);
+		TrackTransaction(endpoint, bytes, size);
+
+		if (shared->outgoing.size() >= kMaxQueuedDatagrams)
+		{
+			packetsDropped_++;
+			return;
+		}
+
+		// Packets queued while a flush is pending ride along with it instead of costing a hop each.
+		shared->outgoing.push_back(Datagram{ packet, remote, -1, dscp });
+		if (shared->outgoing.size() == 1)
+		{
+			sendBatches_++;
+			thread_->PostTask(RTC_FROM_HERE, [this, shared]()
+			{
+				FlushOutgoing(shared);
+			});
+		}
+		packetsSent_++;
+	}
+
+	void UdpMuxShard::FlushOutgoing(const std::shared_ptr<SharedSocket>& shared)
+	{
+		std::vector<Datagram> batch;
+		{
+			rtc::CritScope lock(&crit_);
+			batch.swap(shared->outgoing);
+		}
+		if (!shared->socket)
+			return;
+
+		// Runs of datagrams to the same address, as long as the earlier ones are full sized.
+		for (size_t first = 0; first < batch.size();)
+		{
+			const size_t segment = batch[first].data.size();
+			size_t total = segment;
+			size_t last = first + 1;
+			while (shared->offload && shared->offload->CanSendSegments() &&
+				last < batch.size() && last - first < UdpOffloadSocket::kMaxSegments &&
+				batch[last].remote == batch[first].remote &&
+				batch[last - 1].data.size() == segment && batch[last].data.size() <= segment &&
+				total + batch[last].data.size() <= UdpOffloadSocket::kMaxSegmentedBytes)
+			{
+				total += batch[last].data.size();
+				last++;
+			}
+			SendTrain(shared.get(), &batch[first], last - first);
+			first = last;
+		}
+	}
+
+	void UdpMuxShard::SendTrain(SharedSocket* shared, const Datagram* first, size_t count)
+	{
+		if (count > 1)
+		{
+			rtc::Buffer train;
+			for (size_t i = 0; i < count; i++)
+			{
+				train.AppendData(first[i].data.data(), first[i].data.size());
+			}
+			// Anything but a failed offload is final, a full buffer drops the train like a plain send would.
+			if (shared->offload->SendSegments(train.data(), train.size(), first->data.size(), first->remote) >= 0)
+			{
+				segmentedPackets_ += count;
+				return;
+			}
+			if (shared->offload->CanSendSegments())
+			{
+				sendBufferDrops_ += count;
+				return;
+			}
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			if (shared->socket->SendTo(first[i].data.data<char>(), first[i].data.size(), first[i].remote, rtc::PacketOptions(first[i].dscp)) < 0 &&
+				rtc::IsBlockingError(shared->socket->GetError()))
+			{
+				sendBufferDrops_++;
+			}
+		}
+	}
+
+	void UdpMuxShard::DeliverIncoming(const std::shared_ptr<Endpoint>& endpoint)
+	{
+		std::vector<Datagram> batch;
+		{
+			rtc::CritScope lock(&crit_);
+			batch.swap(endpoint->incoming);
+		}
+		// The socket may go away while one of these is handled.
+		for (auto const& datagram : batch)
+		{
+			if (endpoint->socket)
+				endpoint->socket->Deliver(datagram.data, datagram.remote, datagram.packetTimeUs);
+		}
+	}
+
+	std::shared_ptr<UdpMuxShard::Endpoint> UdpMuxShard::Route(const SharedSocket* shared, const char* data, size_t size, const rtc::SocketAddress& remote)
+	{
+		const auto key = std::make_pair(shared, remote);
+
+		uint16_t type;
+		if (ReadStunType(data, size, &type))
+		{
+			std::string ufrag;
+			if (type == cricket::STUN_BINDING_REQUEST && ReadLocalUfrag(data, size, &ufrag))
+			{
+				// A check names its peer connection, which also claims the sender's address.
+				auto owner = ufrags_.find(ufrag);
+				auto endpoints = owner != ufrags_.end() ? endpoints_.find(owner->second) : endpoints_.end();
+				if (endpoints != endpoints_.end())
+				{
+					for (auto it = endpoints->second.rbegin(); it != endpoints->second.rend(); ++it)
+					{
+						auto endpoint = it->lock();
+						if (endpoint && endpoint->shared.get() == shared)
+						{
+							ClaimRemote(endpoint, remote);
+							return endpoint;
+						}
+					}
+				}
+			}
+			else if (IsStunResponse(type))
+			{
+				auto transaction = transactions_.find(TransactionId(data));
+				if (transaction != transactions_.end())
+				{
+					auto endpoint = transaction->second.endpoint.lock();
+					transactions_.erase(transaction);
+					if (endpoint)
+						return endpoint;
+				}
+			}
+		}
+
+		auto route = remotes_.find(key);
+		if (route == remotes_.end())
+			return nullptr;
+
+		auto endpoint = route->second.lock();
+		if (!endpoint)
+			remotes_.erase(route);
+		return endpoint;
+	}
+
+	void UdpMuxShard::OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size, const rtc::SocketAddress& remote, const int64_t& packet_time_us)
+	{
+		packetsReceived_++;
+
+		// Discovery requests are answered right here, they belong to no peer connection.
+		// |options_| only changes in Start, before any shared socket exists.
+		uint16_t type;
+		if (options_.stunResponder && ReadStunType(data, size, &type) && type == cricket::STUN_BINDING_REQUEST)
+		{
+			rtc::ByteBufferWriter response;
+			if (StunResponder::Answer(data, size, remote, &response))
+			{
+				socket->SendTo(response.Data(), response.Length(), remote, rtc::PacketOptions());
+				stunResponses_++;
+				return;
+			}
+		}
+
+		rtc::CritScope lock(&crit_);
+
+		const SharedSocket* shared = nullptr;
+		for (auto const& entry : sockets_)
+		{
+			if (entry.second->socket.get() == socket)
+				shared = entry.second.get();
+		}
+
+		auto endpoint = shared ? Route(shared, data, size, remote) : nullptr;
+		if (!endpoint || endpoint->released || endpoint->incoming.size() >= kMaxQueuedDatagrams)
+		{
+			packetsDropped_++;
+			return;
+		}
+
+		// Posted under the lock: an endpoint is released before its network thread
+		// goes away, so an unreleased endpoint's thread is still there.
+		endpoint->incoming.push_back(Datagram{ rtc::CopyOnWriteBuffer(data, size), remote, packet_time_us, rtc::DSCP_NO_CHANGE });
+		if (endpoint->incoming.size() == 1)
+		{
+			receiveBatches_++;
+			endpoint->thread->PostTask(RTC_FROM_HERE, [this, endpoint]()
+			{
+				DeliverIncoming(endpoint);
+			});
+		}
+	}
+
+	void UdpMuxShard::AddInfo(RtcUdpMuxInfo* info)
+	{
+		rtc::CritScope lock(&crit_);
+
+		info->sockets += static_cast<uint32_t>(sockets_.size());
+		for (auto const& conductor : endpoints_)
+		{
+			info->endpoints += static_cast<uint32_t>(conductor.second.size());
+		}
+		info->packetsReceived += packetsReceived_;
+		info->packetsSent += packetsSent_;
+		info->packetsDropped += packetsDropped_;
+		info->sendBatches += sendBatches_;
+		info->receiveBatches += receiveBatches_;
+		info->segmentedPackets += segmentedPackets_;
+		info->sendBufferDrops += sendBufferDrops_;
+		info->stunResponses += stunResponses_;
+		for (auto const& shared : sockets_)
+		{
+			if (shared.second->offload)
+				info->coalescedPackets += shared.second->offload->CoalescedPackets();
+		}
+	}
+
+	UdpMux& UdpMux::Instance()
+	{
+		static UdpMux* const mux = new UdpMux();
+		return *mux;
+	}
+
+	bool UdpMux::Start(uint16_t port, size_t shards)
+	{
+		rtc::CritScope lock(&crit_);
+		if (running_ > 0)
+			return port_ == port && running_ == shards;
+		if (shards == 0 || (port != 0 && port + shards - 1 > 0xFFFF))
+			return false;
+
+		// Shards outlive a stop, sockets still held by peers point back at them.
+		while (shards_.size() < shards)
+		{
+			shards_.push_back(std::make_unique<UdpMuxShard>(shards_.size()));
+		}
+		for (size_t i = 0; i < shards; i++)
+		{
+			shards_[i]->Start(port == 0 ? 0 : static_cast<uint16_t>(port + i), options_);
+		}
+		loads_.assign(shards, 0);
+		port_ = port;
+		running_ = shards;
+		return true;
+	}
+
+	void UdpMux::SetSegmentationOffload(bool enabled)
+	{
+		rtc::CritScope lock(&crit_);
+		options_.offload = enabled;
+	}
+
+	void UdpMux::SetSocketBufferSizes(const RtcSocketBufferSizes& buffers)
+	{
+		rtc::CritScope lock(&crit_);
+		options_.buffers = buffers;
+	}
+
+	void UdpMux::SetStunResponder(bool enabled)
+	{
+		rtc::CritScope lock(&crit_);
+		options_.stunResponder = enabled;
+	}
+
+	void UdpMux::Stop()
+	{
+		// Shards never call back into the mux, stopping them under the lock is safe.
+		rtc::CritScope lock(&crit_);
+		for (size_t i = 0; i < running_; i++)
+		{
+			shards_[i]->Stop();
+		}
+		running_ = 0;
+		assignments_.clear();
+		loads_.clear();
+	}
+
+	bool UdpMux::IsRunning() const
+	{
+		rtc::CritScope lock(&crit_);
+		return running_ > 0;
+	}
+
+	std::unique_ptr<rtc::PacketSocketFactory> UdpMux::CreateSocketFactory(RtcConductor* conductor, rtc::Thread* network_thread, const RtcSocketBufferSizes& buffers)
+	{
+		rtc::CritScope lock(&crit_);
+		if (running_ == 0)
+			return nullptr;
+
+		// A peer connection stays on the least loaded shard, with all of its remotes.
+		auto assigned = assignments_.find(conductor);
+		if (assigned == assignments_.end())
+		{
+			const size_t shard = std::min_element(loads_.begin(), loads_.end()) - loads_.begin();
+			loads_[shard]++;
+			assigned = assignments_.emplace(conductor, shard).first;
+		}
+		return shards_[assigned->second]->CreateSocketFactory(conductor, network_thread, buffers);
+	}
+
+	void UdpMux::RegisterUfrag(RtcConductor* conductor, const std::string& ufrag)
+	{
+		rtc::CritScope lock(&crit_);
+		auto assigned = assignments_.find(conductor);
+		if (assigned != assignments_.end())
+			shards_[assigned->second]->RegisterUfrag(conductor, ufrag);
+	}
+
+	void UdpMux::RemoveConductor(RtcConductor* conductor)
+	{
+		rtc::CritScope lock(&crit_);
+		auto assigned = assignments_.find(conductor);
+		if (assigned == assignments_.end())
+			return;
+
+		shards_[assigned->second]->RemoveConductor(conductor);
+		loads_[assigned->second]--;
+		assignments_.erase(assigned);
+	}
+
+	RtcUdpMuxInfo UdpMux::GetInfo()
+	{
+		auto info = RtcUdpMuxInfo();
+		rtc::CritScope lock(&crit_);
+
+		info.shards = static_cast<uint32_t>(running_);
+		for (size_t i = 0; i < running_; i++)
+		{
+			shards_[i]->AddInfo(&info);
+		}
+		return info;
+	}
+}
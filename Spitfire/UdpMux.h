@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SocketBuffers.h"
+#include "api/packet_socket_factory.h"
+#include "rtc_base/async_packet_socket.h"
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/critical_section.h"
+#include "rtc_base/physical_socket_server.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/third_party/sigslot/sigslot.h"
+
+namespace Spitfire
+{
+	class RtcConductor;
+	class UdpMuxSocket;
+	class UdpOffloadSocket;
+
+	struct RtcUdpMuxInfo
+	{
+		uint32_t shards;
+		uint32_t sockets;
+		uint32_t endpoints;
+		uint64_t packetsReceived;
+		uint64_t packetsSent;
+		uint64_t packetsDropped;
+		// Thread hops that carried the packets above, fewer hops means bigger batches.
+		uint64_t sendBatches;
+		uint64_t receiveBatches;
+		// Packets that crossed the kernel in a segmented send or a coalesced read.
+		uint64_t segmentedPackets;
+		uint64_t coalescedPackets;
+		// Sends refused because a shared socket's send buffer was full, local overload rather than network loss.
+		uint64_t sendBufferDrops;
+		uint64_t stunResponses;
+	};
+
+	struct RtcUdpMuxOptions
+	{
+		bool offload = true;
+		RtcSocketBufferSizes buffers;
+		// Answer plain STUN binding requests on the shared sockets.
+		bool stunResponder = false;
+	};
+
+	// Serves the UDP candidates of the peer connections assigned to it from one port
+	// per local address, with its own thread and lock. Incoming STUN requests are
+	// matched to a peer connection by the local ICE ufrag in USERNAME, STUN responses
+	// by transaction id, and the remote addresses learned that way route everything else.
+	class UdpMuxShard : public sigslot::has_slots<>
+	{
+	public:
+		// STUN transactions give up well before this.
+		static const int64_t kTransactionTimeoutMs = 40 * 1000;
+		static const size_t kMaxTransactions = 64 * 1024;
+		// Datagrams a shared socket's outgoing or an endpoint's incoming queue holds while its
+		// thread is behind, anything past this is dropped and counted in packetsDropped.
+		static const size_t kMaxQueuedDatagrams = 4096;
+
+		explicit UdpMuxShard(size_t index);
+
+		void Start(uint16_t port, const RtcUdpMuxOptions& options);
+		void Stop();
+
+		// Socket factory for one conductor. Its first UDP socket per local address shares the
+		// shard's port, any further ones (TURN, ICE restarts) are regular sockets sized by |buffers|.
+		std::unique_ptr<rtc::PacketSocketFactory> CreateSocketFactory(RtcConductor* conductor, rtc::Thread* network_thread, const RtcSocketBufferSizes& buffers);
+
+		// Incoming checks carrying |ufrag| belong to |conductor|.
+		void RegisterUfrag(RtcConductor* conductor, const std::string& ufrag);
+		void RemoveConductor(RtcConductor* conductor);
+
+		void AddInfo(RtcUdpMuxInfo* info);
+
+	private:
+		friend class UdpMuxSocket;
+		friend class UdpMuxSocketFactory;
+
+		struct Datagram
+		{
+			rtc::CopyOnWriteBuffer data;
+			rtc::SocketAddress remote;
+			int64_t packetTimeUs;
+			rtc::DiffServCodePoint dscp;
+		};
+
+		struct SharedSocket
+		{
+			std::unique_ptr<rtc::AsyncPacketSocket> socket;
+			rtc::SocketAddress address;
+			// Owned by |socket|, only touched on the mux thread.
+			UdpOffloadSocket* offload = nullptr;
+			// Guarded by |crit_|, flushed by the one task posted when it was empty.
+			std::vector<Datagram> outgoing;
+		};
+
+		struct Endpoint
+		{
+			RtcConductor* conductor;
+			rtc::Thread* thread;
+			std::shared_ptr<SharedSocket> shared;
+			// Set under |crit_| once the socket is gone, nothing is posted to |thread| after that.
+			bool released = false;
+			// Guarded by |crit_|, delivered by the one task posted when it was empty.
+			std::vector<Datagram> incoming;
+			// Guarded by |crit_|, the remotes routed to this endpoint, dropped from |remotes_| on release.
+			std::set<rtc::SocketAddress> remotes;
+			// Only touched on |thread|.
+			UdpMuxSocket* socket = nullptr;
+		};
+
+		struct Transaction
+		{
+			std::weak_ptr<Endpoint> endpoint;
+			int64_t sentMs;
+		};
+
+		// Returns null when the conductor already has a muxed socket on |ip|.
+		std::shared_ptr<Endpoint> CreateEndpoint(RtcConductor* conductor, rtc::Thread* network_thread, const rtc::IPAddress& ip);
+		void ReleaseEndpoint(const std::shared_ptr<Endpoint>& endpoint);
+		void SendTo(const std::shared_ptr<Endpoint>& endpoint, const void* data, size_t size, const rtc::SocketAddress& remote, const rtc::PacketOptions& options);
+
+		// Run on the mux thread and the endpoint's network thread, each drains its whole queue.
+		void FlushOutgoing(const std::shared_ptr<SharedSocket>& shared);
+		// Sends |count| datagrams to one address starting at |first|, as one segmented send when they allow it.
+		void SendTrain(SharedSocket* shared, const Datagram* first, size_t count);
+		void DeliverIncoming(const std::shared_ptr<Endpoint>& endpoint);
+
+		void OnReadPacket(rtc::AsyncPacketSocket* socket, const char* data, size_t size, const rtc::SocketAddress& remote, const int64_t& packet_time_us);
+		std::shared_ptr<Endpoint> Route(const SharedSocket* shared, const char* data, size_t size, const rtc::SocketAddress& remote);
+		// Routes packets from |remote| on |endpoint|'s socket to it, under |crit_|.
+		void ClaimRemote(const std::shared_ptr<Endpoint>& endpoint, const rtc::SocketAddress& remote);
+		void TrackTransaction(const std::shared_ptr<Endpoint>& endpoint, const char* data, size_t size);
+
+		const size_t index_;
+		mutable rtc::CriticalSection crit_;
+		std::unique_ptr<rtc::Thread> thread_;
+		rtc::PhysicalSocketServer* socketServer_ = nullptr;
+		uint16_t port_ = 0;
+		RtcUdpMuxOptions options_;
+
+		std::map<rtc::IPAddress, std::shared_ptr<SharedSocket>> sockets_;
+		std::map<RtcConductor*, std::vector<std::weak_ptr<Endpoint>>> endpoints_;
+		std::unordered_map<std::string, RtcConductor*> ufrags_;
+		std::map<std::pair<const SharedSocket*, rtc::SocketAddress>, std::weak_ptr<Endpoint>> remotes_;
+		std::unordered_map<std::string, Transaction> transactions_;
+
+		std::atomic<uint64_t> packetsReceived_{ 0 };
+		std::atomic<uint64_t> packetsSent_{ 0 };
+		std::atomic<uint64_t> packetsDropped_{ 0 };
+		std::atomic<uint64_t> sendBatches_{ 0 };
+		std::atomic<uint64_t> receiveBatches_{ 0 };
+		std::atomic<uint64_t> segmentedPackets_{ 0 };
+		std::atomic<uint64_t> sendBufferDrops_{ 0 };
+		std::atomic<uint64_t> stunResponses_{ 0 };
+	};
+
+	// Process wide UDP mux. Windows has no load balancing SO_REUSEPORT, so instead of
+	// several sockets on one port each shard owns its own port and thread. A peer
+	// connection is pinned to one shard and never touches another shard's lock or
+	// socket. Its packets still hop between the shard thread and its own network
+	// thread once per batch each way, see sendBatches and receiveBatches.
+	class UdpMux
+	{
+	public:
+		static UdpMux& Instance();
+
+		// Shard i binds |port| + i, or an ephemeral port each when |port| is zero.
+		// Returns false if the mux already runs with other settings.
+		bool Start(uint16_t port, size_t shards = 1);
+		// Segmentation offload, on by default. Unsupported on the host it falls back to
+		// one datagram per call. Takes effect on the next Start.
+		void SetSegmentationOffload(bool enabled);
+		// Buffer sizes of the shared sockets, they carry every peer on a shard and usually
+		// want far more than the OS default. Takes effect on the next Start.
+		void SetSocketBufferSizes(const RtcSocketBufferSizes& buffers);
+		// Answers plain binding requests on the mux ports, so clients and our own peers
+		// can use them as STUN server. Takes effect on the next Start.
+		void SetStunResponder(bool enabled);
+		void Stop();
+		bool IsRunning() const;
+
+		// Assigns |conductor| to the least loaded shard, null when the mux is not running.
+		std::unique_ptr<rtc::PacketSocketFactory> CreateSocketFactory(RtcConductor* conductor, rtc::Thread* network_thread, const RtcSocketBufferSizes& buffers);
+		void RegisterUfrag(RtcConductor* conductor, const std::string& ufrag);
+		void RemoveConductor(RtcConductor* conductor);
+
+		RtcUdpMuxInfo GetInfo();
+
+	private:
+		UdpMux() = default;
+
+		mutable rtc::CriticalSection crit_;
+		// Only ever grows, sockets held by peers keep pointing at their shard.
+		std::vector<std::unique_ptr<UdpMuxShard>> shards_;
+		size_t running_ = 0;
+		std::vector<uint32_t> loads_;
+		std::map<RtcConductor*, size_t> assignments_;
+		uint16_t port_ = 0;
+		RtcUdpMuxOptions options_;
+	};
+}
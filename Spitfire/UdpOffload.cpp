@@ -0,0 +1,210 @@
+#include "UdpOffload.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "rtc_base/logging.h"
+
+#if defined(WEBRTC_WIN)
+#include <mswsock.h>
+#include <ws2ipdef.h>
+#endif
+
+// USO and URO need the Windows 10 2004 SDK headers, older ones build without offload.
+#if defined(WEBRTC_WIN) && defined(UDP_SEND_MSG_SIZE) && defined(UDP_RECV_MAX_COALESCED_SIZE) && defined(UDP_COALESCED_INFO)
+#define SPITFIRE_UDP_OFFLOAD
+#endif
+
+namespace Spitfire
+{
+	namespace
+	{
+		// Largest coalesced read the OS is asked for.
+		const size_t kMaxCoalescedBytes = 65535;
+
+#if defined(SPITFIRE_UDP_OFFLOAD)
+		// The same for every UDP socket, looked up once.
+		LPFN_WSARECVMSG WsaRecvMsg(SOCKET s)
+		{
+			static const LPFN_WSARECVMSG function = [s]()
+			{
+				GUID guid = WSAID_WSARECVMSG;
+				LPFN_WSARECVMSG loaded = nullptr;
+				DWORD bytes = 0;
+				if (WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &loaded, sizeof(loaded), &bytes, nullptr, nullptr) != 0)
+					return static_cast<LPFN_WSARECVMSG>(nullptr);
+				return loaded;
+			}();
+			return function;
+		}
+#endif
+	}
+
+	UdpOffloadSocket::UdpOffloadSocket(rtc::PhysicalSocketServer* ss) :
+		rtc::SocketDispatcher(ss)
+	{
+	}
+
+	void UdpOffloadSocket::EnableOffload(bool send, bool receive)
+	{
+#if defined(SPITFIRE_UDP_OFFLOAD)
+		if (send)
+		{
+			// The option only reads back where the stack can segment.
+			DWORD value = 0;
+			int length = sizeof(value);
+			sendOffload_ = getsockopt(s_, IPPROTO_UDP, UDP_SEND_MSG_SIZE, reinterpret_cast<char*>(&value), &length) == 0;
+		}
+		if (receive)
+		{
+			DWORD value = static_cast<DWORD>(kMaxCoalescedBytes);
+			receiveOffload_ = WsaRecvMsg(s_) &&
+				setsockopt(s_, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+		}
+#endif
+		RTC_LOG(INFO) << "UDP offload on " << GetLocalAddress().ToString() << ": send " << sendOffload_ << ", receive " << receiveOffload_;
+	}
+
+	int UdpOffloadSocket::SendSegments(const void* data, size_t size, size_t segment, const rtc::SocketAddress& addr)
+	{
+#if defined(SPITFIRE_UDP_OFFLOAD)
+		if (sendOffload_)
+		{
+			sockaddr_storage storage = {};
+			const size_t name_length = addr.ToSockAddrStorage(&storage);
+
+			char control[WSA_CMSG_SPACE(sizeof(DWORD))] = {};
+			WSABUF buffer;
+			buffer.buf = const_cast<char*>(static_cast<const char*>(data));
+			buffer.len = static_cast<ULONG>(size);
+
+			WSAMSG message = {};
+			message.name = reinterpret_cast<LPSOCKADDR>(&storage);
+			message.namelen = static_cast<INT>(name_length);
+			message.lpBuffers = &buffer;
+			message.dwBufferCount = 1;
+			message.Control.buf = control;
+			message.Control.len = sizeof(control);
+
+			WSACMSGHDR* header = WSA_CMSG_FIRSTHDR(&message);
+			header->cmsg_level = IPPROTO_UDP;
+			header->cmsg_type = UDP_SEND_MSG_SIZE;
+			header->cmsg_len = WSA_CMSG_LEN(sizeof(DWORD));
+			*reinterpret_cast<DWORD*>(WSA_CMSG_DATA(header)) = static_cast<DWORD>(segment);
+
+			DWORD sent = 0;
+			if (WSASendMsg(s_, &message, 0, &sent, nullptr, nullptr) == 0)
+				return static_cast<int>(sent);
+
+			UpdateLastError();
+			if (rtc::IsBlockingError(GetError()))
+			{
+				EnableEvents(rtc::DE_WRITE);
+			}
+			else
+			{
+				RTC_LOG(WARNING) << "UDP send offload failed with " << GetError() << ", sending datagrams one by one.";
+				sendOffload_ = false;
+			}
+			return -1;
+		}
+#endif
+		SetError(EINVAL);
+		return -1;
+	}
+
+	int UdpOffloadSocket::RecvFrom(void* buffer, size_t length, rtc::SocketAddress* out_addr, int64_t* timestamp)
+	{
+		if (!pending_.empty())
+		{
+			Segment segment = std::move(pending_.front());
+			pending_.pop_front();
+
+			const size_t size = std::min(length, segment.data.size());
+			std::memcpy(buffer, segment.data.data(), size);
+			if (out_addr)
+				*out_addr = segment.remote;
+			if (timestamp)
+				*timestamp = -1;
+			return static_cast<int>(size);
+		}
+
+#if defined(SPITFIRE_UDP_OFFLOAD)
+		if (receiveOffload_)
+		{
+			readBuffer_.resize(kMaxCoalescedBytes);
+
+			sockaddr_storage storage = {};
+			char control[WSA_CMSG_SPACE(sizeof(DWORD))] = {};
+			WSABUF data;
+			data.buf = &readBuffer_[0];
+			data.len = static_cast<ULONG>(readBuffer_.size());
+
+			WSAMSG message = {};
+			message.name = reinterpret_cast<LPSOCKADDR>(&storage);
+			message.namelen = sizeof(storage);
+			message.lpBuffers = &data;
+			message.dwBufferCount = 1;
+			message.Control.buf = control;
+			message.Control.len = sizeof(control);
+
+			DWORD received = 0;
+			const int result = WsaRecvMsg(s_)(s_, &message, &received, nullptr, nullptr);
+			UpdateLastError();
+			// Like any UDP socket, keep reading after errors.
+			EnableEvents(rtc::DE_READ);
+			if (result != 0)
+				return -1;
+
+			rtc::SocketAddress remote;
+			rtc::SocketAddressFromSockAddrStorage(storage, &remote);
+
+			DWORD segment = 0;
+			for (WSACMSGHDR* header = WSA_CMSG_FIRSTHDR(&message); header; header = WSA_CMSG_NXTHDR(&message, header))
+			{
+				if (header->cmsg_level == IPPROTO_UDP && header->cmsg_type == UDP_COALESCED_INFO)
+					segment = *reinterpret_cast<DWORD*>(WSA_CMSG_DATA(header));
+			}
+
+			// Several datagrams from one sender arrived back to back, keep all but the first.
+			if (segment > 0 && segment < received)
+			{
+				for (DWORD offset = segment; offset < received; offset += segment)
+				{
+					pending_.push_back(Segment{ readBuffer_.substr(offset, std::min<DWORD>(segment, received - offset)), remote });
+				}
+				coalescedPackets_ += 1 + pending_.size();
+				received = segment;
+			}
+
+			const size_t size = std::min<size_t>(length, received);
+			std::memcpy(buffer, readBuffer_.data(), size);
+			if (out_addr)
+				*out_addr = remote;
+			if (timestamp)
+				*timestamp = -1;
+			return static_cast<int>(size);
+		}
+#endif
+		return rtc::SocketDispatcher::RecvFrom(buffer, length, out_addr, timestamp);
+	}
+
+	void UdpOffloadSocket::OnEvent(uint32_t ff, int err)
+	{
+		rtc::SocketDispatcher::OnEvent(ff, err);
+
+		// Every read event hands out one datagram, signal again for the rest of a coalesced read.
+		// Readers on the mux thread never delete the socket from inside the signal.
+		if ((ff & rtc::DE_READ) == 0)
+			return;
+
+		size_t left = pending_.size();
+		while (left > 0)
+		{
+			SignalReadEvent(this);
+			if (pending_.size() >= left)
+				break;
+			left = pending_.size();
+		}
+	}
+}
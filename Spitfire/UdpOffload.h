@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <string>
+
+#include "rtc_base/physical_socket_server.h"
+
+namespace Spitfire
+{
+	// UDP socket using Windows segmentation offload where the OS has it. A train of
+	// equal sized datagrams to one destination leaves in a single send (USO), and
+	// reads may return several coalesced datagrams that are handed out one by one (URO).
+	// Without OS support it behaves like any other physical socket.
+	class UdpOffloadSocket : public rtc::SocketDispatcher
+	{
+	public:
+		// Largest train handed to the OS at once, below the UDP payload limit.
+		static const size_t kMaxSegmentedBytes = 65000;
+		static const size_t kMaxSegments = 64;
+
+		explicit UdpOffloadSocket(rtc::PhysicalSocketServer* ss);
+
+		// Turns on whatever offload this socket supports, call after Create.
+		void EnableOffload(bool send, bool receive);
+		bool CanSendSegments() const
+		{
+			return sendOffload_;
+		}
+
+		// Sends |size| bytes as datagrams of |segment| bytes, the last one may be shorter.
+		// A failure other than a full buffer turns send offload off for good.
+		int SendSegments(const void* data, size_t size, size_t segment, const rtc::SocketAddress& addr);
+
+		int RecvFrom(void* buffer, size_t length, rtc::SocketAddress* out_addr, int64_t* timestamp) override;
+		void OnEvent(uint32_t ff, int err) override;
+
+		uint64_t CoalescedPackets() const
+		{
+			return coalescedPackets_;
+		}
+
+	private:
+		struct Segment
+		{
+			std::string data;
+			rtc::SocketAddress remote;
+		};
+
+		bool sendOffload_ = false;
+		bool receiveOffload_ = false;
+		// Rest of a coalesced read, only touched on the socket server's thread.
+		std::deque<Segment> pending_;
+		std::string readBuffer_;
+		std::atomic<uint64_t> coalescedPackets_{ 0 };
+	};
+}